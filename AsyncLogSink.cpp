@@ -0,0 +1,145 @@
+#include "AsyncLogSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace faf {
+
+/* the writer thread polls, so logging never has to wake it up */
+static constexpr const int writerIdleMs = 10;
+
+AsyncLogSink::AsyncLogSink(rtc::LogSink* target,
+                           std::size_t bufferSize,
+                           LogOverflowPolicy overflowPolicy):
+  _target(target),
+  _overflowPolicy(overflowPolicy)
+{
+  std::size_t capacity = 4096;
+  while (capacity < bufferSize)
+  {
+    capacity *= 2;
+  }
+  _buffer.resize(capacity);
+  _mask = capacity - 1;
+  _thread = std::thread(&AsyncLogSink::_run, this);
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+  stop();
+}
+
+void AsyncLogSink::OnLogMessage(std::string const& message)
+{
+  if (_stopping.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  auto size = std::min(message.size(), _buffer.size() - headerSize);
+  auto head = _head.load(std::memory_order_relaxed);
+  while (_buffer.size() - (head - _tail.load(std::memory_order_acquire)) < headerSize + size)
+  {
+    if (_overflowPolicy == LogOverflowPolicy::Drop ||
+        _stopping.load(std::memory_order_relaxed))
+    {
+      _droppedMessages.fetch_add(1, std::memory_order_relaxed);
+      _producerWaiting.store(false, std::memory_order_relaxed);
+      return;
+    }
+    _producerWaiting.store(true, std::memory_order_relaxed);
+    std::this_thread::yield();
+  }
+  _producerWaiting.store(false, std::memory_order_relaxed);
+  auto length = static_cast<uint32_t>(size);
+  _copyIn(head, reinterpret_cast<const char*>(&length), headerSize);
+  _copyIn(head + headerSize, message.data(), size);
+  _head.store(head + headerSize + size, std::memory_order_release);
+}
+
+void AsyncLogSink::stop()
+{
+  if (_thread.joinable())
+  {
+    _stopping.store(true, std::memory_order_release);
+    _thread.join();
+  }
+}
+
+uint64_t AsyncLogSink::droppedMessages() const
+{
+  return _droppedMessages.load(std::memory_order_relaxed);
+}
+
+void AsyncLogSink::_copyIn(uint64_t position, const char* data, std::size_t size)
+{
+  auto offset = static_cast<std::size_t>(position & _mask);
+  auto first = std::min(size, _buffer.size() - offset);
+  std::memcpy(_buffer.data() + offset, data, first);
+  std::memcpy(_buffer.data(), data + first, size - first);
+}
+
+void AsyncLogSink::_copyOut(uint64_t position, char* data, std::size_t size) const
+{
+  auto offset = static_cast<std::size_t>(position & _mask);
+  auto first = std::min(size, _buffer.size() - offset);
+  std::memcpy(data, _buffer.data() + offset, first);
+  std::memcpy(data + first, _buffer.data(), size - first);
+}
+
+void AsyncLogSink::_run()
+{
+  std::string message;
+  uint64_t reportedDrops = 0;
+  while (true)
+  {
+    /* everything logged before stop() is written */
+    bool stopping = _stopping.load(std::memory_order_acquire);
+    auto tail = _tail.load(std::memory_order_relaxed);
+    auto head = _head.load(std::memory_order_acquire);
+    bool idle = tail == head;
+    while (tail != head)
+    {
+      uint32_t length;
+      _copyOut(tail, reinterpret_cast<char*>(&length), headerSize);
+      message.resize(length);
+      _copyOut(tail + headerSize, &message[0], length);
+      tail += headerSize + length;
+      _tail.store(tail, std::memory_order_release);
+      _write(message);
+    }
+    auto dropped = droppedMessages();
+    if (dropped != reportedDrops)
+    {
+      _write("[warn] FAF: dropped " + std::to_string(dropped - reportedDrops) + " log messages, the log buffer was full\n");
+      reportedDrops = dropped;
+    }
+    if (stopping)
+    {
+      break;
+    }
+    if (_producerWaiting.load(std::memory_order_relaxed))
+    {
+      std::this_thread::yield();
+    }
+    else if (idle)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(writerIdleMs));
+    }
+  }
+}
+
+void AsyncLogSink::_write(std::string const& message)
+{
+  if (_target)
+  {
+    _target->OnLogMessage(message);
+  }
+  else
+  {
+    std::fwrite(message.data(), 1, message.size(), stderr);
+  }
+}
+
+} // namespace faf
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <webrtc/rtc_base/constructormagic.h>
+#include <webrtc/rtc_base/logging.h>
+
+namespace faf {
+
+enum class LogOverflowPolicy
+{
+  Drop,  /*!< drop the message and count it */
+  Block  /*!< wait for the writer thread, for debugging where every line matters */
+};
+
+/*! \brief Log sink writing from a background thread
+ *
+ *  OnLogMessage() copies the formatted message into a preallocated ring
+ *  buffer as [uint32 length][message] records and returns. A writer thread
+ *  passes the records on to the target sink, or to stderr without target.
+ *  rtc::LogMessage calls the sinks under its log lock, so there is only one
+ *  producer at a time and the ring buffer needs no lock.
+ */
+class AsyncLogSink : public rtc::LogSink
+{
+public:
+  /** \param target: The sink called from the writer thread, nullptr for stderr
+       \param bufferSize: The ring buffer size in bytes, rounded up to a power of two
+      */
+  AsyncLogSink(rtc::LogSink* target,
+               std::size_t bufferSize,
+               LogOverflowPolicy overflowPolicy);
+  virtual ~AsyncLogSink();
+
+  virtual void OnLogMessage(std::string const& message) override;
+
+  /** \brief Write the buffered messages and stop the writer thread
+      */
+  void stop();
+
+  uint64_t droppedMessages() const;
+
+  static constexpr const std::size_t headerSize = sizeof(uint32_t);
+
+protected:
+  void _copyIn(uint64_t position, const char* data, std::size_t size);
+  void _copyOut(uint64_t position, char* data, std::size_t size) const;
+  void _run();
+  void _write(std::string const& message);
+
+  rtc::LogSink* _target;
+  LogOverflowPolicy _overflowPolicy;
+  std::vector<char> _buffer;
+  std::size_t _mask;
+  /* write position, only advanced by the producer */
+  std::atomic<uint64_t> _head{0};
+  /* read position, only advanced by the writer thread */
+  std::atomic<uint64_t> _tail{0};
+  std::atomic<uint64_t> _droppedMessages{0};
+  /* a blocked producer keeps the writer thread from sleeping */
+  std::atomic<bool> _producerWaiting{false};
+  std::atomic<bool> _stopping{false};
+  std::thread _thread;
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(AsyncLogSink);
+};
+
+} // namespace faf
@@ -0,0 +1,388 @@
+#include "CborCodec.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace faf {
+
+namespace {
+
+enum CborMajorType : uint8_t
+{
+  UnsignedInt = 0,
+  NegativeInt = 1,
+  ByteString = 2,
+  TextString = 3,
+  Array = 4,
+  Map = 5,
+  Tag = 6,
+  Simple = 7
+};
+
+constexpr uint8_t cborFalse = 0xf4;
+constexpr uint8_t cborTrue = 0xf5;
+constexpr uint8_t cborNull = 0xf6;
+constexpr uint8_t cborUndefined = 0xf7;
+constexpr uint8_t cborFloat16 = 0xf9;
+constexpr uint8_t cborFloat32 = 0xfa;
+constexpr uint8_t cborFloat64 = 0xfb;
+
+void writeBigEndian(uint64_t value, int bytes, std::string& out)
+{
+  for (int i = bytes - 1; i >= 0; --i)
+  {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void writeHead(CborMajorType type, uint64_t argument, std::string& out)
+{
+  uint8_t major = static_cast<uint8_t>(type << 5);
+  if (argument < 24)
+  {
+    out.push_back(static_cast<char>(major | argument));
+  }
+  else if (argument <= 0xff)
+  {
+    out.push_back(static_cast<char>(major | 24));
+    writeBigEndian(argument, 1, out);
+  }
+  else if (argument <= 0xffff)
+  {
+    out.push_back(static_cast<char>(major | 25));
+    writeBigEndian(argument, 2, out);
+  }
+  else if (argument <= 0xffffffff)
+  {
+    out.push_back(static_cast<char>(major | 26));
+    writeBigEndian(argument, 4, out);
+  }
+  else
+  {
+    out.push_back(static_cast<char>(major | 27));
+    writeBigEndian(argument, 8, out);
+  }
+}
+
+void writeText(const char* begin, const char* end, std::string& out)
+{
+  writeHead(TextString, static_cast<uint64_t>(end - begin), out);
+  out.append(begin, end);
+}
+
+} // namespace
+
+void CborCodec::encode(Json::Value const& value, std::string& out)
+{
+  switch (value.type())
+  {
+    case Json::nullValue:
+      out.push_back(static_cast<char>(cborNull));
+      break;
+    case Json::booleanValue:
+      out.push_back(static_cast<char>(value.asBool() ? cborTrue : cborFalse));
+      break;
+    case Json::intValue:
+    {
+      Json::Int64 i = value.asInt64();
+      if (i >= 0)
+      {
+        writeHead(UnsignedInt, static_cast<uint64_t>(i), out);
+      }
+      else
+      {
+        writeHead(NegativeInt, static_cast<uint64_t>(-1 - i), out);
+      }
+      break;
+    }
+    case Json::uintValue:
+      writeHead(UnsignedInt, value.asUInt64(), out);
+      break;
+    case Json::realValue:
+    {
+      double d = value.asDouble();
+      float f = static_cast<float>(d);
+      if (static_cast<double>(f) == d)
+      {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        out.push_back(static_cast<char>(cborFloat32));
+        writeBigEndian(bits, 4, out);
+      }
+      else
+      {
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        out.push_back(static_cast<char>(cborFloat64));
+        writeBigEndian(bits, 8, out);
+      }
+      break;
+    }
+    case Json::stringValue:
+    {
+      const char* begin = nullptr;
+      const char* end = nullptr;
+      value.getString(&begin, &end);
+      writeText(begin, end, out);
+      break;
+    }
+    case Json::arrayValue:
+      writeHead(Array, value.size(), out);
+      for (auto const& element : value)
+      {
+        encode(element, out);
+      }
+      break;
+    case Json::objectValue:
+      writeHead(Map, value.size(), out);
+      for (auto it = value.begin(), end = value.end(); it != end; ++it)
+      {
+        std::string const name = it.name();
+        writeText(name.data(), name.data() + name.size(), out);
+        encode(*it, out);
+      }
+      break;
+  }
+}
+
+namespace {
+
+class CborDecoder
+{
+public:
+  CborDecoder(const char* begin, const char* end):
+    _pos(reinterpret_cast<const uint8_t*>(begin)),
+    _end(reinterpret_cast<const uint8_t*>(end))
+  {
+  }
+
+  bool decodeItem(Json::Value& value, int depth)
+  {
+    if (depth > CborCodec::maxDepth ||
+        _pos == _end)
+    {
+      return false;
+    }
+    uint8_t initial = *_pos++;
+    auto type = static_cast<CborMajorType>(initial >> 5);
+    uint8_t info = initial & 0x1f;
+
+    if (type == Simple)
+    {
+      return _decodeSimple(initial, value);
+    }
+
+    uint64_t argument;
+    if (!_readArgument(info, argument))
+    {
+      return false;
+    }
+    switch (type)
+    {
+      case UnsignedInt:
+        /* like Json::Reader, keep integers signed when they fit */
+        if (argument <= static_cast<uint64_t>(INT64_MAX))
+        {
+          value = Json::Value(static_cast<Json::Int64>(argument));
+        }
+        else
+        {
+          value = Json::Value(static_cast<Json::UInt64>(argument));
+        }
+        return true;
+      case NegativeInt:
+        if (argument > static_cast<uint64_t>(INT64_MAX))
+        {
+          return false;
+        }
+        value = Json::Value(static_cast<Json::Int64>(-1 - static_cast<int64_t>(argument)));
+        return true;
+      case ByteString:
+      case TextString:
+      {
+        if (argument > static_cast<uint64_t>(_end - _pos))
+        {
+          return false;
+        }
+        auto begin = reinterpret_cast<const char*>(_pos);
+        _pos += argument;
+        value = Json::Value(begin, reinterpret_cast<const char*>(_pos));
+        return true;
+      }
+      case Array:
+      {
+        /* every element takes at least one byte */
+        if (argument > static_cast<uint64_t>(_end - _pos))
+        {
+          return false;
+        }
+        value = Json::Value(Json::arrayValue);
+        for (uint64_t i = 0; i < argument; ++i)
+        {
+          if (!decodeItem(value[static_cast<Json::ArrayIndex>(i)], depth + 1))
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+      case Map:
+      {
+        if (argument > static_cast<uint64_t>(_end - _pos) / 2)
+        {
+          return false;
+        }
+        value = Json::Value(Json::objectValue);
+        for (uint64_t i = 0; i < argument; ++i)
+        {
+          if (_pos == _end ||
+              (*_pos >> 5) != TextString)
+          {
+            return false;
+          }
+          Json::Value key;
+          if (!decodeItem(key, depth + 1))
+          {
+            return false;
+          }
+          const char* keyBegin = nullptr;
+          const char* keyEnd = nullptr;
+          key.getString(&keyBegin, &keyEnd);
+          if (!decodeItem(value[std::string(keyBegin, keyEnd)], depth + 1))
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+      default:
+        /* tags are not supported */
+        return false;
+    }
+  }
+
+  bool atEnd() const
+  {
+    return _pos == _end;
+  }
+
+protected:
+  bool _readBigEndian(int bytes, uint64_t& result)
+  {
+    if (_end - _pos < bytes)
+    {
+      return false;
+    }
+    result = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+      result = (result << 8) | *_pos++;
+    }
+    return true;
+  }
+
+  bool _readArgument(uint8_t info, uint64_t& argument)
+  {
+    if (info < 24)
+    {
+      argument = info;
+      return true;
+    }
+    switch (info)
+    {
+      case 24:
+        return _readBigEndian(1, argument);
+      case 25:
+        return _readBigEndian(2, argument);
+      case 26:
+        return _readBigEndian(4, argument);
+      case 27:
+        return _readBigEndian(8, argument);
+      default:
+        /* reserved or indefinite length */
+        return false;
+    }
+  }
+
+  bool _decodeSimple(uint8_t initial, Json::Value& value)
+  {
+    uint64_t bits;
+    switch (initial)
+    {
+      case cborFalse:
+        value = false;
+        return true;
+      case cborTrue:
+        value = true;
+        return true;
+      case cborNull:
+      case cborUndefined:
+        value = Json::Value();
+        return true;
+      case cborFloat16:
+      {
+        if (!_readBigEndian(2, bits))
+        {
+          return false;
+        }
+        int exponent = (bits >> 10) & 0x1f;
+        double mantissa = bits & 0x3ff;
+        double result;
+        if (exponent == 0)
+        {
+          result = std::ldexp(mantissa, -24);
+        }
+        else if (exponent == 31)
+        {
+          result = mantissa == 0 ? INFINITY : NAN;
+        }
+        else
+        {
+          result = std::ldexp(mantissa + 1024, exponent - 25);
+        }
+        value = (bits & 0x8000) ? -result : result;
+        return true;
+      }
+      case cborFloat32:
+      {
+        if (!_readBigEndian(4, bits))
+        {
+          return false;
+        }
+        uint32_t bits32 = static_cast<uint32_t>(bits);
+        float f;
+        std::memcpy(&f, &bits32, sizeof(f));
+        value = static_cast<double>(f);
+        return true;
+      }
+      case cborFloat64:
+      {
+        if (!_readBigEndian(8, bits))
+        {
+          return false;
+        }
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        value = d;
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  const uint8_t* _pos;
+  const uint8_t* _end;
+};
+
+} // namespace
+
+bool CborCodec::decode(const char* begin, const char* end, Json::Value& value)
+{
+  CborDecoder decoder(begin, end);
+  return decoder.decodeItem(value, 0) &&
+         decoder.atEnd();
+}
+
+} // namespace faf
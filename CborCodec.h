@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include <third_party/json/json.h>
+
+namespace faf {
+
+/*! \brief Converts Json::Value trees from and to CBOR (RFC 7049)
+ *
+ *  Only the subset needed to represent JSON is supported: integers, floats,
+ *  text strings, arrays, maps with text string keys, booleans and null. Byte
+ *  strings are decoded as strings, undefined as null. Indefinite length
+ *  items and tags are rejected.
+ */
+class CborCodec
+{
+public:
+  /** \brief Append the CBOR encoding of value to out
+      */
+  static void encode(Json::Value const& value, std::string& out);
+
+  /** \brief Decode exactly one CBOR item spanning [begin, end)
+       \returns false if the data is invalid or unsupported
+      */
+  static bool decode(const char* begin, const char* end, Json::Value& value);
+
+  /* maximum nesting of arrays and maps accepted by decode() */
+  static constexpr const int maxDepth = 64;
+};
+
+} // namespace faf
@@ -0,0 +1,46 @@
+#include "DatagramSocket.h"
+
+#include <memory>
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "logging.h"
+
+namespace faf {
+
+#if defined(WEBRTC_POSIX)
+
+DatagramSocket::DatagramSocket(rtc::PhysicalSocketServer* ss):
+  rtc::SocketDispatcher(ss)
+{
+}
+
+DatagramSocket* DatagramSocket::create(int family)
+{
+  auto ss = static_cast<rtc::PhysicalSocketServer*>(rtc::Thread::Current()->socketserver());
+  auto socket = std::make_unique<DatagramSocket>(ss);
+  if (!socket->Create(family, SOCK_DGRAM))
+  {
+    FAF_LOG_ERROR << "DatagramSocket: unable to create socket";
+    return nullptr;
+  }
+  return socket.release();
+}
+
+void DatagramSocket::OnEvent(uint32_t ff, int err)
+{
+  if ((ff & rtc::DE_READ) != 0 &&
+      !SignalReadable.empty())
+  {
+    ff &= ~rtc::DE_READ;
+    SignalReadable.emit(this);
+  }
+  if (ff != 0)
+  {
+    rtc::SocketDispatcher::OnEvent(ff, err);
+  }
+}
+
+#endif
+
+} // namespace faf
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <webrtc/rtc_base/asyncsocket.h>
+
+#if defined(WEBRTC_POSIX)
+#  include <webrtc/rtc_base/physicalsocketserver.h>
+#endif
+
+#include "Signal.h"
+
+namespace faf {
+
+#if defined(WEBRTC_POSIX)
+
+/*! \brief UDP socket calling its read handler without going through sigslot
+ *
+ *  rtc::SocketDispatcher emits SignalReadEvent with the multi_threaded_local
+ *  policy, which locks a mutex for every read event of the game socket.
+ *  While SignalReadable is connected, read events are emitted on it directly.
+ *  The read notification stays enabled, so the handler has to read until the
+ *  socket would block, but may use any syscall for it.
+ */
+class DatagramSocket : public rtc::SocketDispatcher
+{
+public:
+  explicit DatagramSocket(rtc::PhysicalSocketServer* ss);
+
+  /** \brief Create a UDP socket on the socket server of the current thread
+       \returns nullptr on failure
+      */
+  static DatagramSocket* create(int family);
+
+  virtual void OnEvent(uint32_t ff, int err) override;
+
+  Signal<rtc::AsyncSocket*> SignalReadable;
+};
+
+#endif
+
+} // namespace faf
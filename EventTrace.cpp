@@ -0,0 +1,134 @@
+#include "EventTrace.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#if defined(WEBRTC_POSIX)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include "logging.h"
+
+namespace faf {
+
+static uint64_t steadyNowNs()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#if defined(WEBRTC_POSIX)
+
+bool EventTrace::open(std::string const& path, std::size_t sizeMb)
+{
+  close();
+  std::size_t capacity = sizeMb * 1024 * 1024 / sizeof(TraceRecord);
+  if (capacity == 0)
+  {
+    FAF_LOG_ERROR << "EventTrace: trace size must be at least 1 MB";
+    return false;
+  }
+  std::size_t size = sizeof(TraceHeader) + capacity * sizeof(TraceRecord);
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    FAF_LOG_ERROR << "EventTrace: unable to create " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+  {
+    FAF_LOG_ERROR << "EventTrace: unable to resize " << path << ": " << std::strerror(errno);
+    ::close(fd);
+    return false;
+  }
+  void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  /* the mapping keeps the file referenced */
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    FAF_LOG_ERROR << "EventTrace: unable to map " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  auto header = new (mapping) TraceHeader();
+  std::memcpy(header->magic, magic, sizeof(header->magic));
+  header->version = version;
+  header->recordSize = sizeof(TraceRecord);
+  header->capacity = capacity;
+  header->startTimeNs = steadyNowNs();
+  header->startUnixTimeMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+  header->written.store(0);
+  _header.store(header, std::memory_order_release);
+  _mappedSize = size;
+  _records.store(reinterpret_cast<TraceRecord*>(static_cast<char*>(mapping) + sizeof(TraceHeader)), std::memory_order_release);
+  FAF_LOG_INFO << "EventTrace: tracing " << capacity << " events to " << path;
+  return true;
+}
+
+void EventTrace::close()
+{
+  auto header = _header.load(std::memory_order_acquire);
+  if (!header)
+  {
+    return;
+  }
+  _records.store(nullptr, std::memory_order_release);
+  _header.store(nullptr, std::memory_order_release);
+  ::msync(header, _mappedSize, MS_SYNC);
+  ::munmap(header, _mappedSize);
+  _mappedSize = 0;
+}
+
+#else
+
+bool EventTrace::open(std::string const& path, std::size_t sizeMb)
+{
+  FAF_LOG_ERROR << "EventTrace is not supported on this platform";
+  return false;
+}
+
+void EventTrace::close()
+{
+}
+
+#endif
+
+TraceCandidateType EventTrace::candidateType(std::string const& type)
+{
+  /* cricket::LOCAL_PORT_TYPE etc. */
+  if (type == "local")
+  {
+    return TraceCandidateType::Host;
+  }
+  if (type == "stun")
+  {
+    return TraceCandidateType::ServerReflexive;
+  }
+  if (type == "prflx")
+  {
+    return TraceCandidateType::PeerReflexive;
+  }
+  if (type == "relay")
+  {
+    return TraceCandidateType::Relay;
+  }
+  return TraceCandidateType::Unknown;
+}
+
+void EventTrace::_record(TraceRecord* records, TraceEvent event, int relayId, uint64_t a, uint64_t b)
+{
+  /* the header precedes the records in the mapping */
+  auto header = reinterpret_cast<TraceHeader*>(reinterpret_cast<char*>(records) - sizeof(TraceHeader));
+  auto index = header->written.fetch_add(1, std::memory_order_relaxed);
+  TraceRecord& record = records[index % header->capacity];
+  record.timeNs = steadyNowNs();
+  record.relayId = relayId;
+  record.event = static_cast<uint16_t>(event);
+  record.reserved = 0;
+  record.a = a;
+  record.b = b;
+}
+
+} // namespace faf
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace faf {
+
+/*! \brief Event types of the binary trace, the payload fields a and b per type
+ */
+enum class TraceEvent : uint16_t
+{
+  RelayCreated = 1,     /*!< a: 1 for the offerer */
+  RelayDestroyed,
+  IceConnectionState,   /*!< a: webrtc::PeerConnectionInterface::IceConnectionState */
+  IceGatheringState,    /*!< a: webrtc::PeerConnectionInterface::IceGatheringState */
+  LocalCandidate,       /*!< a: TraceCandidateType */
+  RemoteCandidate,      /*!< a: TraceCandidateType, b: 1 if queued until the remote description is set */
+  LocalDescription,     /*!< a: TraceSdpType, sent to the peer */
+  RemoteDescription,    /*!< a: TraceSdpType, received from the peer */
+  RemoteDescriptionSet, /*!< a: 1 on success */
+  DataChannelState,     /*!< a: webrtc::DataChannelInterface::DataState */
+  Connected,            /*!< a: 1 when connected, 0 when disconnected */
+  PingSent,             /*!< a: sequence number, b: 1 if sequenced */
+  PongReceived,         /*!< a: round trip time in microseconds */
+  PacketFromGame,       /*!< a: size, b: TracePacketAction */
+  PacketToGame,         /*!< a: size */
+  ReconnectFlushed      /*!< a: packets sent, b: packets expired */
+};
+
+enum class TraceCandidateType : uint64_t
+{
+  Host,
+  ServerReflexive,
+  PeerReflexive,
+  Relay,
+  Unknown
+};
+
+enum class TraceSdpType : uint64_t
+{
+  Offer,
+  Answer
+};
+
+enum class TracePacketAction : uint64_t
+{
+  Sent,     /*!< sent as own data channel message */
+  Bundled,  /*!< appended to a bundle */
+  Queued,   /*!< kept while reconnecting */
+  Dropped   /*!< not connected */
+};
+
+/*! \brief One trace record, 32 bytes in host byte order
+ */
+struct TraceRecord
+{
+  uint64_t timeNs;  /*!< steady clock, 0 for an unwritten record */
+  int32_t relayId;  /*!< remote player id */
+  uint16_t event;   /*!< TraceEvent */
+  uint16_t reserved;
+  uint64_t a;
+  uint64_t b;
+};
+static_assert(sizeof(TraceRecord) == 32, "unexpected TraceRecord padding");
+
+/*! \brief Header of the trace file, followed by capacity records
+ *
+ *  The records are a ring, record i is stored at index i % capacity.
+ *  written counts all records, so a trace with more records than
+ *  capacity holds the latest capacity of them.
+ */
+struct TraceHeader
+{
+  char magic[8];            /*!< "FAFTRACE" */
+  uint32_t version;
+  uint32_t recordSize;
+  uint64_t capacity;
+  uint64_t startTimeNs;     /*!< steady clock when the trace was opened */
+  uint64_t startUnixTimeMs; /*!< wall clock when the trace was opened */
+  std::atomic<uint64_t> written;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(TraceHeader) == 64, "unexpected TraceHeader padding");
+
+/*! \brief Process wide binary event trace written to a memory-mapped file
+ *
+ *  Recording is one atomic increment and a 32 byte store into the mapping,
+ *  the kernel writes the pages back to the file. It can be called from
+ *  any thread and does nothing while no trace is open.
+ *  Use faf-ice-trace2json to convert a trace to the Chrome trace event format.
+ *  Only supported on POSIX platforms.
+ *
+ *  close() unmaps the file, so it may only be called once all threads
+ *  which may record have been joined.
+ */
+class EventTrace
+{
+public:
+  static constexpr const char* magic = "FAFTRACE";
+  static constexpr const uint32_t version = 1;
+
+  /** \brief Create the trace file at path with room for sizeMb megabytes of records
+       \returns false on failure
+      */
+  static bool open(std::string const& path, std::size_t sizeMb);
+  /** \brief Unmap the trace, see the class documentation
+      */
+  static void close();
+
+  static bool enabled()
+  {
+    return _records.load(std::memory_order_acquire) != nullptr;
+  }
+
+  static void record(TraceEvent event, int relayId, uint64_t a = 0, uint64_t b = 0)
+  {
+    if (auto records = _records.load(std::memory_order_acquire))
+    {
+      _record(records, event, relayId, a, b);
+    }
+  }
+
+  static TraceCandidateType candidateType(std::string const& type);
+
+protected:
+  static void _record(TraceRecord* records, TraceEvent event, int relayId, uint64_t a, uint64_t b);
+
+  /* _header is set before and cleared after _records */
+  static inline std::atomic<TraceHeader*> _header{nullptr};
+  static inline std::atomic<TraceRecord*> _records{nullptr};
+  static inline std::size_t _mappedSize{0};
+};
+
+} // namespace faf
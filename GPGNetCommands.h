@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace faf
+{
+
+/* chunk types of a GPGNet command schema */
+struct GPGNetInt {};
+struct GPGNetString {};
+
+template<class ChunkType, class Arg>
+struct GPGNetChunkEncoder;
+
+template<class Arg>
+struct GPGNetChunkEncoder<GPGNetInt, Arg>
+{
+  static_assert((std::is_integral<Arg>::value && !std::is_same<Arg, bool>::value) || std::is_enum<Arg>::value,
+                "GPGNet int chunks need an integer or enum argument");
+
+  static constexpr std::size_t size(Arg const&)
+  {
+    return sizeof(int8_t) + sizeof(int32_t);
+  }
+
+  static char* write(char* out, Arg const& arg)
+  {
+    *out++ = 0;
+    int32_t value = static_cast<int32_t>(arg);
+    std::memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+  }
+
+  static void debug(std::ostream& os, Arg const& arg)
+  {
+    os << static_cast<int32_t>(arg);
+  }
+};
+
+template<class Arg>
+struct GPGNetChunkEncoder<GPGNetString, Arg>
+{
+  static_assert(std::is_convertible<Arg const&, std::string_view>::value,
+                "GPGNet string chunks need a string argument");
+
+  static std::size_t size(Arg const& arg)
+  {
+    return sizeof(int8_t) + sizeof(int32_t) + std::string_view(arg).size();
+  }
+
+  static char* write(char* out, Arg const& arg)
+  {
+    std::string_view string(arg);
+    *out++ = 1;
+    int32_t length = static_cast<int32_t>(string.size());
+    std::memcpy(out, &length, sizeof(length));
+    out += sizeof(length);
+    std::memcpy(out, string.data(), string.size());
+    return out + string.size();
+  }
+
+  static void debug(std::ostream& os, Arg const& arg)
+  {
+    os << "\"" << std::string_view(arg) << "\"";
+  }
+};
+
+/*! \brief An outbound GPGNet command with its header and chunk types fixed at compile time
+ *
+ *  Command is a tag type with a `static constexpr char header[]` member,
+ *  Chunks are GPGNetInt or GPGNetString. Arguments of the wrong count or type
+ *  fail to compile. encode() computes the exact message size and writes the
+ *  message in one pass, producing the same bytes as GPGNetMessage::toBinary().
+ */
+template<class Command, class... Chunks>
+struct GPGNetCommand
+{
+  static constexpr std::size_t headerLength = sizeof(Command::header) - 1;
+
+  template<class... Args>
+  static std::size_t size(Args const&... args)
+  {
+    _checkArgumentCount<Args...>();
+    return sizeof(int32_t) + headerLength + sizeof(int32_t) + (std::size_t(0) + ... + GPGNetChunkEncoder<Chunks, Args>::size(args));
+  }
+
+  /** \brief Write the message to out, which must have room for size(args...) bytes
+       \returns The end of the written message
+      */
+  template<class... Args>
+  static char* write(char* out, Args const&... args)
+  {
+    _checkArgumentCount<Args...>();
+    int32_t length = static_cast<int32_t>(headerLength);
+    std::memcpy(out, &length, sizeof(length));
+    out += sizeof(length);
+    std::memcpy(out, Command::header, headerLength);
+    out += headerLength;
+    int32_t chunkCount = static_cast<int32_t>(sizeof...(Chunks));
+    std::memcpy(out, &chunkCount, sizeof(chunkCount));
+    out += sizeof(chunkCount);
+    ((out = GPGNetChunkEncoder<Chunks, Args>::write(out, args)), ...);
+    return out;
+  }
+
+  template<class... Args>
+  static std::string encode(Args const&... args)
+  {
+    std::string result(size(args...), '\0');
+    write(&result[0], args...);
+    return result;
+  }
+
+  /** \brief The same representation as GPGNetMessage::toDebug()
+      */
+  template<class... Args>
+  static std::string toDebug(Args const&... args)
+  {
+    std::ostringstream os;
+    writeDebug(os, args...);
+    return os.str();
+  }
+
+  template<class... Args>
+  static void writeDebug(std::ostream& os, Args const&... args)
+  {
+    _checkArgumentCount<Args...>();
+    os << "GPGNetMessage <" << Command::header << "> [";
+    ((GPGNetChunkEncoder<Chunks, Args>::debug(os, args), os << ", "), ...);
+    os << "]";
+  }
+
+  /* references the arguments until it is streamed, only valid within one statement */
+  template<class... Args>
+  struct Debug
+  {
+    std::tuple<Args const&...> args;
+
+    friend std::ostream& operator<<(std::ostream& os, Debug const& debug)
+    {
+      std::apply([&os](Args const&... args)
+      {
+        GPGNetCommand::writeDebug(os, args...);
+      }, debug.args);
+      return os;
+    }
+  };
+
+  /** \brief The toDebug() representation for a log statement, formatted only when the statement is enabled
+      */
+  template<class... Args>
+  static Debug<Args...> debug(Args const&... args)
+  {
+    return Debug<Args...>{std::tuple<Args const&...>(args...)};
+  }
+
+protected:
+  template<class... Args>
+  static constexpr void _checkArgumentCount()
+  {
+    static_assert(sizeof...(Args) == sizeof...(Chunks), "wrong number of GPGNet chunks");
+  }
+};
+
+namespace gpgnet
+{
+
+struct CreateLobbyTag { static constexpr char header[] = "CreateLobby"; };
+struct ConnectToPeerTag { static constexpr char header[] = "ConnectToPeer"; };
+struct JoinGameTag { static constexpr char header[] = "JoinGame"; };
+struct HostGameTag { static constexpr char header[] = "HostGame"; };
+struct SendNatPacketTag { static constexpr char header[] = "SendNatPacket"; };
+struct DisconnectFromPeerTag { static constexpr char header[] = "DisconnectFromPeer"; };
+struct PingTag { static constexpr char header[] = "ping"; };
+
+/* initMode, lobby port, login, player id, nat traversal provider */
+using CreateLobby = GPGNetCommand<CreateLobbyTag, GPGNetInt, GPGNetInt, GPGNetString, GPGNetInt, GPGNetInt>;
+/* address and port, player name, player id */
+using ConnectToPeer = GPGNetCommand<ConnectToPeerTag, GPGNetString, GPGNetString, GPGNetInt>;
+/* address and port, remote player name, remote player id */
+using JoinGame = GPGNetCommand<JoinGameTag, GPGNetString, GPGNetString, GPGNetInt>;
+/* map */
+using HostGame = GPGNetCommand<HostGameTag, GPGNetString>;
+/* address and port, message */
+using SendNatPacket = GPGNetCommand<SendNatPacketTag, GPGNetString, GPGNetString>;
+/* remote player id */
+using DisconnectFromPeer = GPGNetCommand<DisconnectFromPeerTag, GPGNetInt>;
+using Ping = GPGNetCommand<PingTag>;
+
+} // namespace gpgnet
+
+} // namespace faf
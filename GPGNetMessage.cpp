@@ -1,49 +1,50 @@
 #include "GPGNetMessage.h"
 
 #include <cstdint>
+#include <sstream>
+#include <stdexcept>
 
-#include "logging.h"
+#include "GPGNetParser.h"
 
 namespace faf
 {
 
+static void appendInt32(std::string& result, int32_t value)
+{
+  result.append(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
 std::string GPGNetMessage::toBinary() const
 {
+  std::size_t size = 2 * sizeof(int32_t) + this->header.size();
+  for (auto const& chunk : this->chunks)
+  {
+    size += sizeof(int8_t) + sizeof(int32_t);
+    if (auto string = std::get_if<std::string>(&chunk))
+    {
+      size += string->size();
+    }
+  }
+
   std::string result;
-  int32_t headerLength = this->header.size();
-  int32_t chunkCount = this->chunks.size();
-  result.append(reinterpret_cast<char*>(&headerLength), sizeof(headerLength));
-  result.append(this->header.c_str(), this->header.size());
-  result.append(reinterpret_cast<char*>(&chunkCount), sizeof(chunkCount));
+  result.reserve(size);
+  appendInt32(result, static_cast<int32_t>(this->header.size()));
+  result.append(this->header);
+  appendInt32(result, static_cast<int32_t>(this->chunks.size()));
 
-  for(const auto chunk : this->chunks)
+  for (auto const& chunk : this->chunks)
   {
-    int8_t typeCode;
-    switch (chunk.type())
+    if (auto value = std::get_if<int32_t>(&chunk))
     {
-      case Json::intValue:
-      case Json::uintValue:
-      case Json::booleanValue:
-      {
-        typeCode = 0;
-        result.append(reinterpret_cast<char*>(&typeCode), sizeof(typeCode));
-        int32_t value = chunk.asInt();
-        result.append(reinterpret_cast<char*>(&value), sizeof(value));
-      }
-        break;
-      case Json::stringValue:
-      {
-        typeCode = 1;
-        result.append(reinterpret_cast<char*>(&typeCode), sizeof(typeCode));
-        auto string = chunk.asString();
-        int32_t stringLength = string.size();
-        result.append(reinterpret_cast<char*>(&stringLength), sizeof(stringLength));
-        result.append(string.c_str(), string.size());
-      }
-        break;
-      default:
-        FAF_LOG_ERROR << "Unsupported Json chunk type " << chunk.type();
-        break;
+      result.push_back(0);
+      appendInt32(result, *value);
+    }
+    else
+    {
+      auto const& string = std::get<std::string>(chunk);
+      result.push_back(1);
+      appendInt32(result, static_cast<int32_t>(string.size()));
+      result.append(string);
     }
   }
   return result;
@@ -57,87 +58,60 @@ std::string GPGNetMessage::toDebug() const
         "> [";
   for(auto const& chunk : this->chunks)
   {
-    os<< chunk << ", ";
+    if (auto value = std::get_if<int32_t>(&chunk))
+    {
+      os << *value << ", ";
+    }
+    else
+    {
+      os << "\"" << std::get<std::string>(chunk) << "\", ";
+    }
   }
   os << "]";
   return os.str();
 }
 
-void GPGNetMessage::parse(std::string& msgBuffer, std::function<void (GPGNetMessage const&)> cb)
+GPGNetMessage GPGNetMessage::fromView(GPGNetMessageView const& view)
 {
-  while(true)
+  GPGNetMessage message;
+  message.header = std::string(view.header);
+  message.chunks.reserve(view.chunks.size());
+  for (auto const& chunk : view.chunks)
   {
-    auto it = msgBuffer.begin();
-
-    int32_t headerLength;
-    if ((msgBuffer.end() - it) <= sizeof(int32_t))
+    if (chunk.type == 0)
     {
-      return;
+      message.chunks.emplace_back(std::in_place_type<int32_t>, chunk.intValue);
     }
-    headerLength = *reinterpret_cast<int32_t*>(&*it);
-    it += sizeof(int32_t);
-    if ((msgBuffer.end() - it) < headerLength)
+    else
     {
-      return;
-    }
-
-    GPGNetMessage message;
-    message.header = std::string(&*it, headerLength);
-    it += headerLength;
-
-    int32_t chunkCount;
-    if ((msgBuffer.end() - it) < sizeof(int32_t))
-    {
-      return;
-    }
-    chunkCount = *reinterpret_cast<int32_t*>(&*it);
-    it += sizeof (int32_t);
-    message.chunks.resize(chunkCount);
-
-    for (int chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
-    {
-      int8_t type;
-      if ((msgBuffer.end() - it) < sizeof(int8_t))
-      {
-        return;
-      }
-      type = *reinterpret_cast<int8_t*>(&*it);
-      it += sizeof(int8_t);
-      int32_t length;
-      if ((msgBuffer.end() - it) < sizeof(int32_t))
-      {
-        return;
-      }
-      length = *reinterpret_cast<int32_t*>(&*it);
-      it += sizeof(int32_t);
-
-      // Special-case for int (which uses the length field to hold the payload).
-      if (type == 0)
-      {
-        message.chunks[chunkIndex] = length;
-        continue;
-      }
-
-      if (type != 1)
-      {
-        FAF_LOG_ERROR << "GPGNetMessage type " << static_cast<int>(type) << " not supported";
-        return;
-      }
-
-      if ((msgBuffer.end() - it) < length)
-      {
-        return;
-      }
-      message.chunks[chunkIndex] = std::string(&*it, length);
-      it += length;
+      message.chunks.emplace_back(std::in_place_type<std::string>, chunk.stringValue);
     }
+  }
+  return message;
+}
 
-    cb(message);
-    /* Now move the remaining bytes in the buffer to the start
-     * of the buffer */
-    msgBuffer.erase(msgBuffer.begin(), it);
+Json::Value GPGNetMessage::chunkToJson(GPGNetChunk const& chunk)
+{
+  if (auto value = std::get_if<int32_t>(&chunk))
+  {
+    return Json::Value(*value);
   }
+  return Json::Value(std::get<std::string>(chunk));
+}
 
+GPGNetChunk GPGNetMessage::chunkFromJson(Json::Value const& value)
+{
+  switch (value.type())
+  {
+    case Json::intValue:
+    case Json::uintValue:
+    case Json::booleanValue:
+      return GPGNetChunk(std::in_place_type<int32_t>, value.asInt());
+    case Json::stringValue:
+      return GPGNetChunk(std::in_place_type<std::string>, value.asString());
+    default:
+      throw std::runtime_error("Unsupported GPGNet chunk type " + std::to_string(value.type()));
+  }
 }
 
 }
@@ -1,28 +1,41 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <functional>
+#include <variant>
+#include <vector>
+
 #include <third_party/json/json.h>
 
 namespace faf
 {
 
+struct GPGNetMessageView;
+
+/*! \brief A GPGNet parameter, the wire format knows int32 (type 0) and string (type 1)
+ */
+using GPGNetChunk = std::variant<int32_t, std::string>;
+
 struct GPGNetMessage
 {
   std::string header; /*!< Message type like "CreateLobby" or "ConnectToPeer" */
-  std::vector<Json::Value> chunks; /*!< parameters */
+  std::vector<GPGNetChunk> chunks; /*!< parameters */
 
   std::string toBinary() const;
   std::string toDebug() const;
 
-  /** \brief Parse a GPGNetMessage from char*
-       \param start: Start of the buffer
-       \param maxSize: End of the buffer
-       \param result: The result on success
-       \returns The number of bytes read from the buffer on success
-                Or 0 on failure
+  /** \brief Copy a message parsed by the GPGNetParser out of the parser buffer
+      */
+  static GPGNetMessage fromView(GPGNetMessageView const& view);
+
+  /** \brief Convert a chunk for the JSON-RPC interface
+      */
+  static Json::Value chunkToJson(GPGNetChunk const& chunk);
+
+  /** \brief Convert a chunk from the JSON-RPC interface
+       \throws std::runtime_error if the value is neither a number, a bool nor a string
       */
-  static void parse(std::string& msgBuffer, std::function<void (GPGNetMessage const&)> cb);
+  static GPGNetChunk chunkFromJson(Json::Value const& value);
 };
 
 }
@@ -0,0 +1,200 @@
+#include "GPGNetParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "logging.h"
+
+namespace faf
+{
+
+GPGNetParser::GPGNetParser(std::size_t initialCapacity):
+  _buffer(initialCapacity)
+{
+}
+
+char* GPGNetParser::prepare(std::size_t minSize)
+{
+  if (_buffer.size() - _end < minSize)
+  {
+    if (_begin > 0)
+    {
+      /* only the unparsed rest is moved, consumed messages are just dropped */
+      std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+      _parsePos -= _begin;
+      _end -= _begin;
+      _begin = 0;
+    }
+    if (_buffer.size() - _end < minSize)
+    {
+      _buffer.resize(std::max(2 * _buffer.size(), _end + minSize));
+    }
+  }
+  return _buffer.data() + _end;
+}
+
+void GPGNetParser::commit(std::size_t size)
+{
+  _end += size;
+}
+
+void GPGNetParser::append(const char* data, std::size_t size)
+{
+  std::memcpy(prepare(size), data, size);
+  commit(size);
+}
+
+bool GPGNetParser::_readInt32(int32_t& value)
+{
+  if (_end - _parsePos < sizeof(int32_t))
+  {
+    return false;
+  }
+  std::memcpy(&value, _buffer.data() + _parsePos, sizeof(int32_t));
+  _parsePos += sizeof(int32_t);
+  return true;
+}
+
+bool GPGNetParser::_parseNext()
+{
+  while (true)
+  {
+    switch (_state)
+    {
+      case State::HeaderLength:
+        if (!_readInt32(_headerLength))
+        {
+          return false;
+        }
+        if (_headerLength < 0)
+        {
+          FAF_LOG_ERROR << "GPGNetMessage header length " << _headerLength << " invalid";
+          _reset();
+          return false;
+        }
+        _state = State::Header;
+        break;
+      case State::Header:
+        if (_end - _parsePos < std::size_t(_headerLength))
+        {
+          return false;
+        }
+        _parsePos += std::size_t(_headerLength);
+        _state = State::ChunkCount;
+        break;
+      case State::ChunkCount:
+        if (!_readInt32(_chunkCount))
+        {
+          return false;
+        }
+        if (_chunkCount < 0)
+        {
+          FAF_LOG_ERROR << "GPGNetMessage chunk count " << _chunkCount << " invalid";
+          _reset();
+          return false;
+        }
+        _chunkRecords.clear();
+        if (_chunkCount == 0)
+        {
+          _completeMessage();
+          return true;
+        }
+        _state = State::ChunkType;
+        break;
+      case State::ChunkType:
+        if (_end == _parsePos)
+        {
+          return false;
+        }
+        _chunkType = static_cast<int8_t>(_buffer[_parsePos]);
+        ++_parsePos;
+        if (_chunkType != 0 &&
+            _chunkType != 1)
+        {
+          FAF_LOG_ERROR << "GPGNetMessage type " << static_cast<int>(_chunkType) << " not supported";
+          _reset();
+          return false;
+        }
+        _state = State::ChunkLength;
+        break;
+      case State::ChunkLength:
+        if (!_readInt32(_chunkLength))
+        {
+          return false;
+        }
+        /* ints use the length field to hold the payload */
+        if (_chunkType == 0)
+        {
+          _chunkRecords.push_back({_chunkType, _chunkLength, 0});
+          if (_chunkRecords.size() == std::size_t(_chunkCount))
+          {
+            _completeMessage();
+            return true;
+          }
+          _state = State::ChunkType;
+          break;
+        }
+        if (_chunkLength < 0)
+        {
+          FAF_LOG_ERROR << "GPGNetMessage string length " << _chunkLength << " invalid";
+          _reset();
+          return false;
+        }
+        _state = State::ChunkData;
+        break;
+      case State::ChunkData:
+        if (_end - _parsePos < std::size_t(_chunkLength))
+        {
+          return false;
+        }
+        _chunkRecords.push_back({_chunkType, _chunkLength, _parsePos - _begin});
+        _parsePos += std::size_t(_chunkLength);
+        if (_chunkRecords.size() == std::size_t(_chunkCount))
+        {
+          _completeMessage();
+          return true;
+        }
+        _state = State::ChunkType;
+        break;
+    }
+  }
+}
+
+void GPGNetParser::_completeMessage()
+{
+  const char* message = _buffer.data() + _begin;
+  _message.header = std::string_view(message + sizeof(int32_t), std::size_t(_headerLength));
+  _message.chunks.clear();
+  for (auto const& record : _chunkRecords)
+  {
+    if (record.type == 0)
+    {
+      _message.chunks.push_back({record.type, record.value, std::string_view()});
+    }
+    else
+    {
+      _message.chunks.push_back({record.type, 0, std::string_view(message + record.offset, std::size_t(record.value))});
+    }
+  }
+}
+
+void GPGNetParser::_consumeMessage()
+{
+  _begin = _parsePos;
+  _state = State::HeaderLength;
+  if (_begin == _end)
+  {
+    _begin = _parsePos = _end = 0;
+  }
+}
+
+void GPGNetParser::_reset()
+{
+  /* the stream has no resynchronization points, drop everything received so far */
+  ++_errors;
+  _begin = _parsePos = _end = 0;
+  _state = State::HeaderLength;
+  _chunkRecords.clear();
+}
+
+} // namespace faf
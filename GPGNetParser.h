@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace faf
+{
+
+/*! \brief A parameter of a received GPGNet message
+ *
+ *  The string points into the buffer of the GPGNetParser and is only valid
+ *  during the callback of GPGNetParser::parse().
+ */
+struct GPGNetChunkView
+{
+  int8_t type;                  /*!< 0: int, 1: string */
+  int32_t intValue;
+  std::string_view stringValue;
+};
+
+struct GPGNetMessageView
+{
+  std::string_view header;
+  std::vector<GPGNetChunkView> chunks;
+};
+
+/*! \brief Incremental parser for the GPGNet stream of the game
+ *
+ *  The socket data is received directly into a slab buffer via prepare() and
+ *  commit(). The parser remembers how far it got into a partial message and
+ *  continues from there when more data arrives. Consumed messages are not
+ *  erased from the buffer, only the remaining partial message is moved to the
+ *  front when the free space at the end runs out.
+ */
+class GPGNetParser
+{
+public:
+  explicit GPGNetParser(std::size_t initialCapacity = 4096);
+
+  /** \brief Get a write pointer with at least minSize writable bytes
+      */
+  char* prepare(std::size_t minSize);
+
+  /** \brief Mark size bytes written to the pointer returned by prepare() as received
+      */
+  void commit(std::size_t size);
+
+  void append(const char* data, std::size_t size);
+
+  /** \brief Call cb(GPGNetMessageView const&) for every complete message in the buffer
+      */
+  template<class Callback>
+  void parse(Callback&& cb)
+  {
+    while (_parseNext())
+    {
+      cb(_message);
+      _consumeMessage();
+    }
+  }
+
+  std::size_t bufferedSize() const
+  {
+    return _end - _begin;
+  }
+
+  /** \brief The number of times the stream was reset because of invalid data
+      */
+  uint64_t errors() const
+  {
+    return _errors;
+  }
+
+protected:
+  enum class State
+  {
+    HeaderLength,
+    Header,
+    ChunkCount,
+    ChunkType,
+    ChunkLength,
+    ChunkData
+  };
+
+  /* chunk positions are stored relative to the message start
+   * because the buffer may be compacted while a message is partial */
+  struct ChunkRecord
+  {
+    int8_t type;
+    int32_t value;
+    std::size_t offset;
+  };
+
+  bool _parseNext();
+  bool _readInt32(int32_t& value);
+  void _completeMessage();
+  void _consumeMessage();
+  void _reset();
+
+  std::vector<char> _buffer;
+  std::size_t _begin{0};     /*!< start of the current message */
+  std::size_t _parsePos{0};  /*!< end of the parsed part of the current message */
+  std::size_t _end{0};       /*!< end of the received data */
+
+  State _state{State::HeaderLength};
+  int32_t _headerLength{0};
+  int32_t _chunkCount{0};
+  int8_t _chunkType{0};
+  int32_t _chunkLength{0};
+  std::vector<ChunkRecord> _chunkRecords;
+  GPGNetMessageView _message;
+  uint64_t _errors{0};
+};
+
+} // namespace faf
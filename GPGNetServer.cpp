@@ -1,16 +1,19 @@
 #include "GPGNetServer.h"
 
+#include <cstdlib>
 #include <iostream>
 
 #include <webrtc/rtc_base/nethelpers.h>
 #include <webrtc/rtc_base/asynctcpsocket.h>
 
 #include "logging.h"
+#include "UnixSocket.h"
 
 namespace faf {
 
 GPGNetConnectionHandler::GPGNetConnectionHandler(rtc::AsyncSocket* socket):
-  _socket(socket)
+  _socket(socket),
+  _writeQueue(socket)
 {
   rtc::SocketAddress accept_addr;
   _socket->SignalReadEvent.connect(this, &GPGNetConnectionHandler::_onRead);
@@ -20,7 +23,15 @@ GPGNetConnectionHandler::GPGNetConnectionHandler(rtc::AsyncSocket* socket):
 
 void GPGNetConnectionHandler::send(std::string const& msg)
 {
-  _socket->Send(msg.c_str(), msg.length());
+  if (!_writeQueue.send(msg.c_str(), msg.length()))
+  {
+    FAF_LOG_ERROR << "GPGNetConnectionHandler: dropping message for failed socket";
+  }
+}
+
+SocketWriteQueue const& GPGNetConnectionHandler::writeQueue() const
+{
+  return _writeQueue;
 }
 
 void GPGNetConnectionHandler::_onClientDisconnect(rtc::AsyncSocket* socket, int _whatsThis_)
@@ -36,13 +47,14 @@ void GPGNetConnectionHandler::_onRead(rtc::AsyncSocket* socket)
   int msgLength = 0;
   do
   {
-    msgLength = socket->Recv(_readBuffer.data(), _readBuffer.size(), nullptr);
+    msgLength = socket->Recv(_parser.prepare(readSize), readSize, nullptr);
 
     if (msgLength > 0)
     {
-      _currentMsg.append(_readBuffer.data(), std::size_t(msgLength));
-      GPGNetMessage::parse(_currentMsg, [this](GPGNetMessage const& msg)
+      _parser.commit(std::size_t(msgLength));
+      _parser.parse([this](GPGNetMessageView const& view)
       {
+        auto msg = GPGNetMessage::fromView(view);
         FAF_LOG_TRACE << "GPGNetServer received " << msg.toDebug();
         SignalNewGPGNetMessage.emit(msg);
       });
@@ -52,7 +64,13 @@ void GPGNetConnectionHandler::_onRead(rtc::AsyncSocket* socket)
 }
 
 GPGNetServer::GPGNetServer():
-  _server(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(SOCK_STREAM))
+  _server(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(SOCK_STREAM)),
+  _messagesFromGame(MetricsRegistry::global().counter("faf_gpgnet_messages_total",
+                                                      "GPGNet messages exchanged with the game",
+                                                      MetricsRegistry::labels({{"direction", "from_game"}}))),
+  _messagesToGame(MetricsRegistry::global().counter("faf_gpgnet_messages_total",
+                                                    "GPGNet messages exchanged with the game",
+                                                    MetricsRegistry::labels({{"direction", "to_game"}})))
 {
 }
 
@@ -66,6 +84,28 @@ void GPGNetServer::listen(int port)
   FAF_LOG_INFO << "GPGNetServer listening on port " << _server->GetLocalAddress().port();
 }
 
+GPGNetServer::~GPGNetServer()
+{
+  if (_unixServer)
+  {
+    _unixServer->Close();
+    unix_socket_unlink(_unixSocketPath);
+  }
+}
+
+void GPGNetServer::listenUnix(std::string const& path)
+{
+  _unixServer.reset(unix_socket_listen(path));
+  if (!_unixServer)
+  {
+    FAF_LOG_ERROR << "unable to listen on UNIX socket " << path;
+    std::exit(1);
+  }
+  _unixSocketPath = path;
+  _unixServer->SignalReadEvent.connect(this, &GPGNetServer::_onNewClient);
+  FAF_LOG_INFO << "GPGNetServer listening on " << path;
+}
+
 int GPGNetServer::listenPort() const
 {
   return _server->GetLocalAddress().port();
@@ -76,14 +116,20 @@ bool GPGNetServer::hasConnectedClient() const
   return !_connectedSockets.empty();
 }
 
-void GPGNetServer::sendMessage(GPGNetMessage const& msg)
+Json::Value GPGNetServer::writeQueueStatus() const
 {
-  auto msgString = msg.toBinary();
-  FAF_LOG_INFO << "GPGNetServer::sendMessage: " << msg.toDebug();
-  for(auto it = _connectedSockets.begin(), end = _connectedSockets.end(); it != end; ++it)
+  SocketWriteQueueStats stats;
+  for (auto handler : _connectedSockets)
   {
-    (*it)->send(msgString);
+    stats.add(handler->writeQueue());
   }
+  return stats.toJson();
+}
+
+void GPGNetServer::sendMessage(GPGNetMessage const& msg)
+{
+  FAF_LOG_INFO << "GPGNetServer::sendMessage: " << msg.toDebug();
+  _sendToClients(msg.toBinary());
 }
 
 void GPGNetServer::sendCreateLobby(InitMode initMode,
@@ -92,96 +138,78 @@ void GPGNetServer::sendCreateLobby(InitMode initMode,
                                    int playerId,
                                    int natTraversalProvider)
 {
-  GPGNetMessage msg;
-  msg.header = "CreateLobby";
-  msg.chunks = {
-    static_cast<std::underlying_type<InitMode>::type>(initMode),
-    port,
-    login,
-    playerId,
-    natTraversalProvider
-  };
-  sendMessage(msg);
+  _sendCommand<gpgnet::CreateLobby>(initMode,
+                                    port,
+                                    login,
+                                    playerId,
+                                    natTraversalProvider);
 }
 
 void GPGNetServer::sendConnectToPeer(std::string const& addressAndPort,
                                      std::string const& playerName,
                                      int playerId)
 {
-  GPGNetMessage msg;
-  msg.header = "ConnectToPeer";
-  msg.chunks = {
-    addressAndPort,
-    playerName,
-    playerId
-  };
-  sendMessage(msg);
-  FAF_LOG_INFO << "sending ConnectToPeer " << playerId << " " << playerName << " " << addressAndPort;
+  _sendCommand<gpgnet::ConnectToPeer>(addressAndPort,
+                                      playerName,
+                                      playerId);
 }
 
 void GPGNetServer::sendJoinGame(std::string const& addressAndPort,
                                 std::string const& remotePlayerName,
                                 int remotePlayerId)
 {
-  GPGNetMessage msg;
-  msg.header = "JoinGame";
-  msg.chunks = {
-    addressAndPort,
-    remotePlayerName,
-    remotePlayerId
-  };
-  sendMessage(msg);
+  _sendCommand<gpgnet::JoinGame>(addressAndPort,
+                                 remotePlayerName,
+                                 remotePlayerId);
 }
 
 void GPGNetServer::sendHostGame(std::string const& map)
 {
-  GPGNetMessage msg;
-  msg.header = "HostGame";
-  msg.chunks = {
-    map
-  };
-  sendMessage(msg);
+  _sendCommand<gpgnet::HostGame>(map);
 }
 
 void GPGNetServer::sendSendNatPacket(std::string const& addressAndPort,
                                      std::string const& message)
 {
-  GPGNetMessage msg;
-  msg.header = "SendNatPacket";
-  msg.chunks = {
-    addressAndPort,
-    message
-  };
-  sendMessage(msg);
+  _sendCommand<gpgnet::SendNatPacket>(addressAndPort,
+                                      message);
 }
 
 void GPGNetServer::sendDisconnectFromPeer(int remotePlayerId)
 {
-  GPGNetMessage msg;
-  msg.header = "DisconnectFromPeer";
-  msg.chunks = {
-    remotePlayerId
-  };
-  sendMessage(msg);
+  _sendCommand<gpgnet::DisconnectFromPeer>(remotePlayerId);
 }
 
 void GPGNetServer::sendPing()
 {
-  GPGNetMessage msg;
-  msg.header = "ping";
-  sendMessage(msg);
+  _sendCommand<gpgnet::Ping>();
+}
+
+void GPGNetServer::_sendToClients(std::string const& data)
+{
+  _messagesToGame->inc();
+  for(auto it = _connectedSockets.begin(), end = _connectedSockets.end(); it != end; ++it)
+  {
+    (*it)->send(data);
+  }
 }
 
 void GPGNetServer::_onNewClient(rtc::AsyncSocket* socket)
 {
-  if (socket != _server.get())
+  if (socket != _server.get() &&
+      socket != _unixServer.get())
   {
     FAF_LOG_ERROR << "??";
     return;
   }
   rtc::SocketAddress accept_addr;
 
-  auto handler = new GPGNetConnectionHandler(_server->Accept(&accept_addr));
+  auto clientSocket = socket->Accept(&accept_addr);
+  if (!clientSocket)
+  {
+    return;
+  }
+  auto handler = new GPGNetConnectionHandler(clientSocket);
   _connectedSockets.insert(handler);
   handler->SignalNewGPGNetMessage.connect(this, &GPGNetServer::_onClientMessage);
   handler->SignalClientDisconnected.connect(this, &GPGNetServer::_onClientDisconnect);
@@ -193,8 +221,9 @@ void GPGNetServer::_onClientDisconnect(GPGNetConnectionHandler* handler)
   rtc::Thread::Current()->Post(RTC_FROM_HERE, this, 0, new rtc::TypedMessageData<GPGNetConnectionHandler*>(handler));
 }
 
-void GPGNetServer::_onClientMessage(GPGNetMessage msg)
+void GPGNetServer::_onClientMessage(GPGNetMessage const& msg)
 {
+  _messagesFromGame->inc();
   SignalNewGPGNetMessage.emit(msg);
 }
 
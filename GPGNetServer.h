@@ -8,7 +8,13 @@
 #include <webrtc/rtc_base/asyncsocket.h>
 #include <webrtc/rtc_base/messagehandler.h>
 
+#include "GPGNetCommands.h"
 #include "GPGNetMessage.h"
+#include "GPGNetParser.h"
+#include "logging.h"
+#include "Metrics.h"
+#include "Signal.h"
+#include "SocketWriteQueue.h"
 
 namespace faf {
 
@@ -25,16 +31,19 @@ public:
 
   void send(std::string const& msg);
 
-  sigslot::signal1<GPGNetMessage, sigslot::multi_threaded_local> SignalNewGPGNetMessage;
-  sigslot::signal1<GPGNetConnectionHandler*, sigslot::multi_threaded_local> SignalClientDisconnected;
+  SocketWriteQueue const& writeQueue() const;
+
+  Signal<GPGNetMessage const&> SignalNewGPGNetMessage;
+  Signal<GPGNetConnectionHandler*> SignalClientDisconnected;
 
 protected:
   void _onClientDisconnect(rtc::AsyncSocket* socket, int);
   void _onRead(rtc::AsyncSocket* socket);
 
   rtc::AsyncSocket* _socket;
-  std::array<char, 2048> _readBuffer;
-  std::string _currentMsg;
+  static constexpr const std::size_t readSize = 2048;
+  GPGNetParser _parser;
+  SocketWriteQueue _writeQueue;
   RTC_DISALLOW_COPY_AND_ASSIGN(GPGNetConnectionHandler);
 };
 
@@ -42,13 +51,23 @@ class GPGNetServer : public sigslot::has_slots<>, public rtc::MessageHandler
 {
 public:
   GPGNetServer();
+  virtual ~GPGNetServer();
 
   void listen(int port);
 
+  /** \brief Additionally serve the clients connecting to the AF_UNIX stream socket at path
+       The game itself only connects via TCP, this is meant for local tools and tests.
+      */
+  void listenUnix(std::string const& path);
+
   int listenPort() const;
 
   bool hasConnectedClient() const;
 
+  /** \brief Outbound queue statistics summed up over all connected clients
+      */
+  Json::Value writeQueueStatus() const;
+
   void sendMessage(GPGNetMessage const& msg);
 
   void sendCreateLobby(InitMode initMode,
@@ -74,17 +93,28 @@ public:
 
   void sendPing();
 
-  sigslot::signal1<GPGNetMessage, sigslot::multi_threaded_local> SignalNewGPGNetMessage;
-  sigslot::signal0<sigslot::multi_threaded_local> SignalClientConnected;
-  sigslot::signal0<sigslot::multi_threaded_local> SignalClientDisconnected;
+  Signal<GPGNetMessage const&> SignalNewGPGNetMessage;
+  Signal<> SignalClientConnected;
+  Signal<> SignalClientDisconnected;
 protected:
   void _onNewClient(rtc::AsyncSocket* socket);
   void _onClientDisconnect(GPGNetConnectionHandler* handler);
-  void _onClientMessage(GPGNetMessage msg);
+  void _onClientMessage(GPGNetMessage const& msg);
+  template<class Command, class... Args>
+  void _sendCommand(Args const&... args)
+  {
+    FAF_LOG_INFO << "GPGNetServer::sendMessage: " << Command::debug(args...);
+    _sendToClients(Command::encode(args...));
+  }
+  void _sendToClients(std::string const& data);
   void _onRead(rtc::AsyncSocket* socket);
   virtual void OnMessage(rtc::Message* msg) override;
   std::unique_ptr<rtc::AsyncSocket> _server;
+  std::unique_ptr<rtc::AsyncSocket> _unixServer;
+  std::string _unixSocketPath;
   std::set<GPGNetConnectionHandler*> _connectedSockets;
+  std::shared_ptr<Counter> _messagesFromGame;
+  std::shared_ptr<Counter> _messagesToGame;
 
   RTC_DISALLOW_COPY_AND_ASSIGN(GPGNetServer);
 };
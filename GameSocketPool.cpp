@@ -0,0 +1,275 @@
+#include "GameSocketPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(WEBRTC_LINUX)
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#  include <webrtc/rtc_base/physicalsocketserver.h>
+#endif
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "DatagramSocket.h"
+#include "logging.h"
+#include "PeerRelay.h"
+
+namespace faf {
+
+#if defined(WEBRTC_LINUX)
+
+/* The socket is read with recvmmsg() to get the destination address of each
+ * datagram, which bypasses PhysicalSocket::Recv(). The DatagramSocket keeps
+ * the read notification of the dispatcher enabled. */
+class GameSocket : public DatagramSocket
+{
+public:
+  explicit GameSocket(rtc::PhysicalSocketServer* ss):
+    DatagramSocket(ss)
+  {
+  }
+};
+
+#else
+
+class GameSocket
+{
+};
+
+#endif
+
+GameSocketPool::GameSocketPool(std::size_t socketCount)
+{
+#if defined(WEBRTC_LINUX)
+  auto ss = static_cast<rtc::PhysicalSocketServer*>(rtc::Thread::Current()->socketserver());
+  for (std::size_t i = 0; i < socketCount; ++i)
+  {
+    auto gameSocket = std::make_unique<GameSocket>(ss);
+    if (!gameSocket->Create(AF_INET, SOCK_DGRAM))
+    {
+      FAF_LOG_ERROR << "GameSocketPool: unable to create socket";
+      continue;
+    }
+    int enable = 1;
+    if (setsockopt(gameSocket->GetDescriptor(), IPPROTO_IP, IP_PKTINFO, &enable, sizeof(enable)) != 0)
+    {
+      FAF_LOG_ERROR << "GameSocketPool: unable to enable IP_PKTINFO";
+      continue;
+    }
+    if (gameSocket->Bind(rtc::SocketAddress("0.0.0.0", 0)) != 0)
+    {
+      FAF_LOG_ERROR << "GameSocketPool: unable to bind socket";
+      continue;
+    }
+    gameSocket->SignalReadable.connect(this, &GameSocketPool::_onRead);
+    Socket s;
+    s.port = gameSocket->GetLocalAddress().port();
+    s.socket = std::move(gameSocket);
+    FAF_LOG_INFO << "GameSocketPool listening on UDP port " << s.port;
+    _sockets.push_back(std::move(s));
+  }
+#else
+  FAF_LOG_ERROR << "GameSocketPool is not supported on this platform";
+#endif
+}
+
+GameSocketPool::~GameSocketPool()
+{
+}
+
+bool GameSocketPool::supported()
+{
+#if defined(WEBRTC_LINUX)
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::optional<rtc::SocketAddress> GameSocketPool::add(PeerRelay* relay)
+{
+  auto socketIt = std::min_element(_sockets.begin(), _sockets.end(), [](Socket const& a, Socket const& b)
+  {
+    return a.relayCount < b.relayCount;
+  });
+  if (socketIt == _sockets.end())
+  {
+    return std::nullopt;
+  }
+  for (std::size_t octet = firstRelayOctet; octet <= lastRelayOctet; ++octet)
+  {
+    if (!socketIt->relays[octet])
+    {
+      socketIt->relays[octet] = relay;
+      ++socketIt->relayCount;
+      return rtc::SocketAddress((127u << 24) | octet, socketIt->port);
+    }
+  }
+  return std::nullopt;
+}
+
+void GameSocketPool::remove(PeerRelay* relay)
+{
+  for (auto& s : _sockets)
+  {
+    for (auto& r : s.relays)
+    {
+      if (r == relay)
+      {
+        r = nullptr;
+        --s.relayCount;
+      }
+    }
+  }
+}
+
+bool GameSocketPool::sendToGame(rtc::SocketAddress const& relayAddress,
+                                rtc::SocketAddress const& gameAddress,
+                                const uint8_t* data,
+                                std::size_t size)
+{
+#if defined(WEBRTC_LINUX)
+  auto socketIt = std::find_if(_sockets.begin(), _sockets.end(), [&relayAddress](Socket const& s)
+  {
+    return s.port == relayAddress.port();
+  });
+  if (socketIt == _sockets.end())
+  {
+    return false;
+  }
+
+  sockaddr_in destination;
+  gameAddress.ToSockAddr(&destination);
+  iovec iov;
+  iov.iov_base = const_cast<uint8_t*>(data);
+  iov.iov_len = size;
+  std::array<char, CMSG_SPACE(sizeof(in_pktinfo))> control{};
+  msghdr msg = msghdr();
+  msg.msg_name = &destination;
+  msg.msg_namelen = sizeof(destination);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  /* select the relay's loopback address as source address */
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_IP;
+  cmsg->cmsg_type = IP_PKTINFO;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+  in_pktinfo pktinfo = in_pktinfo();
+  pktinfo.ipi_spec_dst.s_addr = htonl(relayAddress.ip());
+  std::memcpy(CMSG_DATA(cmsg), &pktinfo, sizeof(pktinfo));
+
+  return sendmsg(socketIt->socket->GetDescriptor(), &msg, MSG_DONTWAIT) == static_cast<ssize_t>(size);
+#else
+  return false;
+#endif
+}
+
+Json::Value GameSocketPool::status() const
+{
+  Json::Value result;
+  Json::Value ports(Json::arrayValue);
+  std::size_t relayCount = 0;
+  for (auto const& s : _sockets)
+  {
+    ports.append(s.port);
+    relayCount += s.relayCount;
+  }
+  result["ports"] = ports;
+  result["relays"] = Json::UInt64(relayCount);
+  result["read_wakeups"] = Json::UInt64(_readWakeups);
+  result["read_syscalls"] = Json::UInt64(_readSyscalls);
+  result["read_datagrams"] = Json::UInt64(_readDatagrams);
+  result["dropped_datagrams"] = Json::UInt64(_droppedDatagrams);
+  return result;
+}
+
+void GameSocketPool::_onRead(rtc::AsyncSocket* socket)
+{
+#if defined(WEBRTC_LINUX)
+  auto socketIt = std::find_if(_sockets.begin(), _sockets.end(), [socket](Socket const& s)
+  {
+    return s.socket.get() == socket;
+  });
+  if (socketIt == _sockets.end())
+  {
+    return;
+  }
+  ++_readWakeups;
+
+  std::array<mmsghdr, readBatchSize> msgs;
+  std::array<iovec, readBatchSize> iovecs;
+  std::array<sockaddr_in, readBatchSize> sources;
+  std::array<std::array<char, CMSG_SPACE(sizeof(in_pktinfo))>, readBatchSize> controls;
+  _readRelays.clear();
+  while (true)
+  {
+    for (std::size_t i = 0; i < readBatchSize; ++i)
+    {
+      iovecs[i].iov_base = _readBuffers[i].data();
+      iovecs[i].iov_len = _readBuffers[i].size();
+      msgs[i] = mmsghdr();
+      msgs[i].msg_hdr.msg_name = &sources[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = controls[i].data();
+      msgs[i].msg_hdr.msg_controllen = controls[i].size();
+    }
+    int received = recvmmsg(socketIt->socket->GetDescriptor(), msgs.data(), readBatchSize, MSG_DONTWAIT, nullptr);
+    ++_readSyscalls;
+    if (received <= 0)
+    {
+      break;
+    }
+    _readDatagrams += std::size_t(received);
+    for (int i = 0; i < received; ++i)
+    {
+      if ((ntohl(sources[i].sin_addr.s_addr) >> 24) != 127)
+      {
+        ++_droppedDatagrams;
+        continue;
+      }
+      PeerRelay* relay = nullptr;
+      for (auto cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+      {
+        if (cmsg->cmsg_level == IPPROTO_IP &&
+            cmsg->cmsg_type == IP_PKTINFO)
+        {
+          in_pktinfo pktinfo;
+          std::memcpy(&pktinfo, CMSG_DATA(cmsg), sizeof(pktinfo));
+          auto destination = ntohl(pktinfo.ipi_addr.s_addr);
+          if ((destination >> 8) == 0x7f0000)
+          {
+            relay = socketIt->relays[destination & 0xff];
+          }
+        }
+      }
+      if (!relay)
+      {
+        ++_droppedDatagrams;
+        continue;
+      }
+      relay->onGameDatagram(_readBuffers[i].data(), msgs[i].msg_len);
+      if (std::find(_readRelays.begin(), _readRelays.end(), relay) == _readRelays.end())
+      {
+        _readRelays.push_back(relay);
+      }
+    }
+    if (std::size_t(received) < readBatchSize)
+    {
+      break;
+    }
+  }
+  for (auto relay : _readRelays)
+  {
+    relay->onGameDatagramsDone();
+  }
+#endif
+}
+
+} // namespace faf
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <webrtc/rtc_base/asyncsocket.h>
+#include <webrtc/rtc_base/socketaddress.h>
+
+#include <third_party/json/json.h>
+
+namespace faf {
+
+class PeerRelay;
+class GameSocket;
+
+/*! \brief A small pool of UDP sockets shared by all PeerRelays for the game traffic
+ *
+ *  Instead of binding one socket per PeerRelay, every relay is assigned its own
+ *  loopback address 127.0.0.x on one of the shared sockets. Datagrams from the game
+ *  are routed to the relay by their destination address, and datagrams to the game
+ *  are sent with the relay's address as source address, so the game still sees one
+ *  address per peer.
+ *
+ *  The sockets are bound to the wildcard address to receive on every loopback
+ *  address. Datagrams which don't originate from a loopback address are dropped.
+ *  Only supported on Linux. Must be used on the network thread.
+ */
+class GameSocketPool : public sigslot::has_slots<>
+{
+public:
+  explicit GameSocketPool(std::size_t socketCount);
+  virtual ~GameSocketPool();
+
+  static bool supported();
+
+  /** \brief Register a relay to receive the game packets sent to its address
+       \returns The address the game has to send the relay's packets to,
+                or nothing if the pool is exhausted
+      */
+  std::optional<rtc::SocketAddress> add(PeerRelay* relay);
+
+  void remove(PeerRelay* relay);
+
+  /** \brief Send a packet to the game using the relay's address as source
+      */
+  bool sendToGame(rtc::SocketAddress const& relayAddress,
+                  rtc::SocketAddress const& gameAddress,
+                  const uint8_t* data,
+                  std::size_t size);
+
+  Json::Value status() const;
+
+protected:
+  void _onRead(rtc::AsyncSocket* socket);
+
+  /* 127.0.0.1 is the game's own address, 127.0.0.255 is reserved */
+  static constexpr const std::size_t firstRelayOctet = 2;
+  static constexpr const std::size_t lastRelayOctet = 254;
+  static constexpr const std::size_t readBatchSize = 32;
+  static constexpr const std::size_t readBufferSize = 2048;
+
+  struct Socket
+  {
+    std::unique_ptr<GameSocket> socket;
+    int port{0};
+    std::array<PeerRelay*, 256> relays{};
+    std::size_t relayCount{0};
+  };
+  std::vector<Socket> _sockets;
+  std::array<std::array<uint8_t, readBufferSize>, readBatchSize> _readBuffers;
+  /* the relays which received packets in the current read event */
+  std::vector<PeerRelay*> _readRelays;
+
+  uint64_t _readWakeups{0};
+  uint64_t _readSyscalls{0};
+  uint64_t _readDatagrams{0};
+  uint64_t _droppedDatagrams{0};
+};
+
+} // namespace faf
@@ -12,19 +12,67 @@
 
 namespace faf {
 
+/* create an object which must be created and destroyed on the given thread */
+template<typename T, typename FactoryT>
+static std::shared_ptr<T> createOnThread(rtc::Thread* thread, FactoryT const& factory)
+{
+  auto object = thread->Invoke<T*>(RTC_FROM_HERE, factory);
+  return std::shared_ptr<T>(object, [thread](T* o)
+  {
+    thread->Invoke<void>(RTC_FROM_HERE, [o]()
+    {
+      delete o;
+    });
+  });
+}
+
 IceAdapter::IceAdapter(IceAdapterOptions const& options):
   _options(options),
+  _mainThread(rtc::Thread::Current()),
+  _networkThread(rtc::Thread::CreateWithSocketServer()),
+  _workerThread(rtc::Thread::Create()),
   _gpgnetGameState("None"),
+  _relayCount(MetricsRegistry::global().gauge("faf_relays", "Number of PeerRelays")),
   _gametaskString("Idle"),
   _lobbyInitMode("normal"),
   _lobbyPort(_options.gameUdpPort)
 {
+  _jsonRpcServer.setNotificationBatchWindow(_options.rpcNotificationBatchMs);
   _jsonRpcServer.listen(_options.rpcPort);
+  if (!_options.rpcSocketPath.empty())
+  {
+    _jsonRpcServer.listenUnix(_options.rpcSocketPath);
+  }
   _gpgnetServer.listen(_options.gpgNetPort);
+  if (!_options.gpgNetSocketPath.empty())
+  {
+    _gpgnetServer.listenUnix(_options.gpgNetSocketPath);
+  }
 
-  _pcfactory = webrtc::CreateModularPeerConnectionFactory(nullptr,
-                                                          nullptr,
-                                                          nullptr,
+  _networkThread->SetName("faf-network", nullptr);
+  _networkThread->Start();
+  _workerThread->SetName("faf-worker", nullptr);
+  _workerThread->Start();
+
+  _mainLoopLag = std::make_unique<LoopLagMonitor>("main");
+  _networkLoopLag = createOnThread<LoopLagMonitor>(_networkThread.get(), []()
+  {
+    return new LoopLagMonitor("network");
+  });
+  if (_options.metricsPort > 0)
+  {
+    _metricsServer = std::make_unique<MetricsServer>();
+    if (!_metricsServer->listen(_options.metricsPort))
+    {
+      _metricsServer.reset();
+    }
+  }
+
+  /* Using the network thread as signaling thread keeps the game packets
+   * on a single thread from the game socket to the SCTP transport. */
+  _pcfactory = webrtc::CreateModularPeerConnectionFactory(_networkThread.get(),
+                                                          _workerThread.get(),
+                                                          _networkThread.get(),
                                                           nullptr,
                                                           nullptr,
                                                           nullptr,
@@ -40,6 +88,21 @@ IceAdapter::IceAdapter(IceAdapterOptions const& options):
     std::exit(1);
   }
 
+  if (_options.gameSocketPoolSize > 0)
+  {
+    if (GameSocketPool::supported())
+    {
+      _gameSocketPool = createOnThread<GameSocketPool>(_networkThread.get(), [this]()
+      {
+        return new GameSocketPool(std::size_t(_options.gameSocketPoolSize));
+      });
+    }
+    else
+    {
+      FAF_LOG_WARN << "game socket pool not supported on this platform, using one socket per peer";
+    }
+  }
+
   /* ICE adapter should determine lobby port. This may fail due to race conditions, but we can't pass a socket to the game */
   if (_lobbyPort == 0)
   {
@@ -103,6 +166,7 @@ void IceAdapter::disconnectFromPeer(int remotePlayerId)
     return;
   }
   _relays.erase(relayIt);
+  _relayCount->set(int64_t(_relays.size()));
   FAF_LOG_INFO << "removed relay for peer " << remotePlayerId;
   _queueGameTask({IceAdapterGameTask::DisconnectFromPeer,
                   "",
@@ -123,7 +187,11 @@ void IceAdapter::iceMsg(int remotePlayerId, Json::Value const& msg)
     FAF_LOG_ERROR << "no relay for remote peer " << remotePlayerId << " found";
     return;
   }
-  relayIt->second->addIceMessage(msg);
+  auto relay = relayIt->second;
+  _networkThread->Invoke<void>(RTC_FROM_HERE, [relay, &msg]()
+  {
+    relay->addIceMessage(msg);
+  });
 }
 
 void IceAdapter::sendToGpgNet(GPGNetMessage const& message)
@@ -165,10 +233,13 @@ void IceAdapter::setIceServers(Json::Value const& servers)
       FAF_LOG_DEBUG << dbgMsg;
     }
   }
-  for(auto it = _relays.begin(), end = _relays.end(); it != end; ++it)
+  _networkThread->Invoke<void>(RTC_FROM_HERE, [this]()
   {
-    it->second->setIceServers(_iceServers);
-  }
+    for(auto it = _relays.begin(), end = _relays.end(); it != end; ++it)
+    {
+      it->second->setIceServers(_iceServers);
+    }
+  });
 }
 
 Json::Value IceAdapter::status() const
@@ -186,10 +257,25 @@ Json::Value IceAdapter::status() const
     options["player_login"]         = std::string(_options.localPlayerLogin);
     options["rpc_port"]             = _jsonRpcServer.listenPort();
     options["gpgnet_port"]          = _gpgnetServer.listenPort();
+    options["rpc_socket"]           = _options.rpcSocketPath;
+    options["gpgnet_socket"]        = _options.gpgNetSocketPath;
     options["lobby_port"]           = _options.gameUdpPort;
+    options["game_socket_pool_size"] = _options.gameSocketPoolSize;
+    options["bundle_packets"]       = _options.bundlePackets;
+    options["bundle_window_us"]     = _options.bundleWindowUs;
+    options["reconnect_buffer_packets"] = _options.reconnectBufferPackets;
+    options["reconnect_buffer_ms"]  = _options.reconnectBufferMs;
+    options["negotiated_datachannel"] = _options.negotiatedDataChannel;
+    options["rtt_probe_interval_ms"] = _options.rttProbeIntervalMs;
+    options["rpc_notification_batch_ms"] = _options.rpcNotificationBatchMs;
     options["log_file"]             = std::string(_options.logDirectory);
+    options["log_buffer_kb"]        = _options.logBufferKb;
+    options["log_overflow"]         = _options.logOverflow;
+    options["trace_file"]           = _options.traceFile;
+    options["metrics_port"]         = _options.metricsPort;
     result["options"] = options;
   }
+  result["log_dropped_messages"] = Json::UInt64(logging_dropped_messages());
   /* GPGNet */
   {
     Json::Value gpgnet;
@@ -198,17 +284,36 @@ Json::Value IceAdapter::status() const
     gpgnet["connected"] = _gpgnetServer.hasConnectedClient();
     gpgnet["game_state"] = _gpgnetGameState;
     gpgnet["task_string"] = _gametaskString;
+    gpgnet["write_queue"] = _gpgnetServer.writeQueueStatus();
     result["gpgnet"] = gpgnet;
   }
+  /* JSON-RPC */
+  {
+    Json::Value rpc;
+    rpc["write_queue"] = _jsonRpcServer.writeQueueStatus();
+    rpc["requests"] = _jsonRpcServer.pendingRequestsStatus();
+    result["rpc"] = rpc;
+  }
   /* Relays */
   {
     Json::Value relays(Json::arrayValue);
-    for (auto it = _relays.begin(), end = _relays.end(); it != end; ++it)
+    _networkThread->Invoke<void>(RTC_FROM_HERE, [this, &relays]()
     {
-      relays.append(it->second->status());
-    }
+      for (auto it = _relays.begin(), end = _relays.end(); it != end; ++it)
+      {
+        relays.append(it->second->status());
+      }
+    });
     result["relays"] = relays;
   }
+  /* Game socket pool */
+  if (_gameSocketPool)
+  {
+    result["game_socket_pool"] = _networkThread->Invoke<Json::Value>(RTC_FROM_HERE, [this]()
+    {
+      return _gameSocketPool->status();
+    });
+  }
   return result;
 }
 
@@ -219,6 +324,11 @@ IceAdapterOptions const& IceAdapter::options() const
 
 void IceAdapter::_connectRpcMethods()
 {
+  /* a client which can't keep up only needs the latest state */
+  _jsonRpcServer.setMergeableNotification("onConnectionStateChanged", 0);
+  _jsonRpcServer.setMergeableNotification("onIceConnectionStateChanged", 2);
+  _jsonRpcServer.setMergeableNotification("onConnected", 2);
+
   _jsonRpcServer.setRpcCallback("quit",
                              [](Json::Value const& paramsArray,
                                 Json::Value & result,
@@ -384,7 +494,7 @@ void IceAdapter::_connectRpcMethods()
       message.header = paramsArray[0].asString();
       for(std::size_t i = 0; i < paramsArray[1].size(); ++i)
       {
-        message.chunks.push_back(paramsArray[1][Json::ArrayIndex(i)]);
+        message.chunks.push_back(GPGNetMessage::chunkFromJson(paramsArray[1][Json::ArrayIndex(i)]));
       }
       sendToGpgNet(message);
       result = "ok";
@@ -469,13 +579,13 @@ void IceAdapter::_tryExecuteGameTasks()
         {
           if (task.task == IceAdapterGameTask::JoinGame)
           {
-            _gpgnetServer.sendJoinGame(std::string("127.0.0.1:") + std::to_string(relayIt->second->localUdpSocketPort()),
+            _gpgnetServer.sendJoinGame(relayIt->second->localGameAddress().ToString(),
                                        task.remoteLogin,
                                        task.remoteId);
           }
           else
           {
-            _gpgnetServer.sendConnectToPeer(std::string("127.0.0.1:") + std::to_string(relayIt->second->localUdpSocketPort()),
+            _gpgnetServer.sendConnectToPeer(relayIt->second->localGameAddress().ToString(),
                                             task.remoteLogin,
                                             task.remoteId);
           }
@@ -509,16 +619,18 @@ void IceAdapter::_onGameDisconnected()
   _gametaskString = "Idle";
   _gpgnetGameState = "None";
   _relays.clear();
+  _relayCount->set(0);
 }
 
-void IceAdapter::_onGpgNetMessage(GPGNetMessage message)
+void IceAdapter::_onGpgNetMessage(GPGNetMessage const& message)
 {
   FAF_LOG_DEBUG << "received GPGnet message: " << message.toDebug();
   if (message.header == "GameState")
   {
-    if (message.chunks.size() == 1)
+    if (message.chunks.size() == 1 &&
+        std::holds_alternative<std::string>(message.chunks[0]))
     {
-      _gpgnetGameState = message.chunks[0].asString();
+      _gpgnetGameState = std::get<std::string>(message.chunks[0]);
       if (_gpgnetGameState == "Idle")
       {
         _gpgnetServer.sendCreateLobby(_lobbyInitMode == "normal" ? InitMode::NormalLobby : InitMode::AutoLobby,
@@ -535,7 +647,7 @@ void IceAdapter::_onGpgNetMessage(GPGNetMessage message)
   Json::Value msgChunks(Json::arrayValue);
   for(auto const& chunk : message.chunks)
   {
-    msgChunks.append(chunk);
+    msgChunks.append(GPGNetMessage::chunkToJson(chunk));
   }
   rpcParams.append(msgChunks);
   _jsonRpcServer.sendRequest("onGpgNetMessageReceived",
@@ -560,48 +672,69 @@ void IceAdapter::_createPeerRelay(int remotePlayerId,
     return;
   }
 
+  /* relay callbacks are called on the network thread */
   PeerRelay::Callbacks callbacks;
   callbacks.iceMessageCallback = [this, remotePlayerId](Json::Value iceMsg)
   {
-    Json::Value onIceMsgParams(Json::arrayValue);
-    onIceMsgParams.append(_options.localPlayerId);
-    onIceMsgParams.append(remotePlayerId);
-    onIceMsgParams.append(iceMsg);
-    _jsonRpcServer.sendRequest("onIceMsg",
-                               onIceMsgParams);
+    _invoker.AsyncInvoke<void>(RTC_FROM_HERE, _mainThread, [this, remotePlayerId, iceMsg]()
+    {
+      Json::Value onIceMsgParams(Json::arrayValue);
+      onIceMsgParams.append(_options.localPlayerId);
+      onIceMsgParams.append(remotePlayerId);
+      onIceMsgParams.append(iceMsg);
+      _jsonRpcServer.sendRequest("onIceMsg",
+                                 onIceMsgParams);
+    });
   };
 
   callbacks.stateCallback = [this, remotePlayerId](std::string state)
   {
-    Json::Value onIceStateChangedParams(Json::arrayValue);
-    onIceStateChangedParams.append(_options.localPlayerId);
-    onIceStateChangedParams.append(remotePlayerId);
-    onIceStateChangedParams.append(state);
-    _jsonRpcServer.sendRequest("onIceConnectionStateChanged",
-                               onIceStateChangedParams);
+    _invoker.AsyncInvoke<void>(RTC_FROM_HERE, _mainThread, [this, remotePlayerId, state]()
+    {
+      Json::Value onIceStateChangedParams(Json::arrayValue);
+      onIceStateChangedParams.append(_options.localPlayerId);
+      onIceStateChangedParams.append(remotePlayerId);
+      onIceStateChangedParams.append(state);
+      _jsonRpcServer.sendRequest("onIceConnectionStateChanged",
+                                 onIceStateChangedParams);
+    });
   };
 
   callbacks.connectedCallback = [this, remotePlayerId](bool connected)
   {
-    Json::Value onConnectedParams(Json::arrayValue);
-    onConnectedParams.append(_options.localPlayerId);
-    onConnectedParams.append(remotePlayerId);
-    onConnectedParams.append(connected);
-    _jsonRpcServer.sendRequest("onConnected",
-                               onConnectedParams);
-  };
-
-  PeerRelay::Options options = {
-    remotePlayerId,
-    remotePlayerLogin,
-    createOffer,
-    _lobbyPort,
-    _iceServers
+    _invoker.AsyncInvoke<void>(RTC_FROM_HERE, _mainThread, [this, remotePlayerId, connected]()
+    {
+      Json::Value onConnectedParams(Json::arrayValue);
+      onConnectedParams.append(_options.localPlayerId);
+      onConnectedParams.append(remotePlayerId);
+      onConnectedParams.append(connected);
+      _jsonRpcServer.sendRequest("onConnected",
+                                 onConnectedParams);
+    });
   };
 
-  _relays[remotePlayerId] = std::make_shared<PeerRelay>(options,
-                                                        callbacks,
-                                                        _pcfactory);
+  PeerRelay::Options options;
+  options.remotePlayerId = remotePlayerId;
+  options.remotePlayerLogin = remotePlayerLogin;
+  options.isOfferer = createOffer;
+  options.gameUdpPort = _lobbyPort;
+  options.iceServers = _iceServers;
+  options.gameSocketPool = _gameSocketPool.get();
+  options.bundlePackets = _options.bundlePackets;
+  options.bundleWindowUs = _options.bundleWindowUs;
+  options.reconnectBufferPackets = _options.reconnectBufferPackets;
+  options.reconnectBufferMs = _options.reconnectBufferMs;
+  options.negotiatedDataChannel = _options.negotiatedDataChannel;
+  options.rttProbeIntervalMs = _options.rttProbeIntervalMs;
+
+  /* the relay must be created and destroyed on the network thread */
+  _relays[remotePlayerId] = createOnThread<PeerRelay>(_networkThread.get(), [this, &options, &callbacks]()
+  {
+    return new PeerRelay(options,
+                         callbacks,
+                         _pcfactory);
+  });
+  _relayCount->set(int64_t(_relays.size()));
 }
 
 } // namespace faf
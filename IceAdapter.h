@@ -4,11 +4,17 @@
 #include <memory>
 
 #include <webrtc/rtc_base/scoped_ref_ptr.h>
+#include <webrtc/rtc_base/asyncinvoker.h>
+#include <webrtc/rtc_base/thread.h>
 #include <webrtc/api/peerconnectioninterface.h>
 
 #include "IceAdapterOptions.h"
+#include "GameSocketPool.h"
 #include "GPGNetServer.h"
 #include "JsonRpcServer.h"
+#include "LoopLagMonitor.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
 #include "PeerRelay.h"
 
 namespace faf {
@@ -101,18 +107,30 @@ protected:
   void _tryExecuteGameTasks();
   void _onGameConnected();
   void _onGameDisconnected();
-  void _onGpgNetMessage(GPGNetMessage message);
+  void _onGpgNetMessage(GPGNetMessage const& message);
   void _createPeerRelay(int remotePlayerId,
                         std::string const& remotePlayerLogin,
                         bool createOffer);
 
   IceAdapterOptions _options;
+  /* The main thread runs the JSON-RPC and GPGNet servers.
+   * The PeerRelays and their game sockets live on the network thread,
+   * which is also the signaling thread of the PeerConnections. */
+  rtc::Thread* _mainThread;
+  std::unique_ptr<rtc::Thread> _networkThread;
+  std::unique_ptr<rtc::Thread> _workerThread;
+  std::unique_ptr<LoopLagMonitor> _mainLoopLag;
+  std::shared_ptr<LoopLagMonitor> _networkLoopLag;
   rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> _pcfactory;
   GPGNetServer _gpgnetServer;
   JsonRpcServer _jsonRpcServer;
+  rtc::AsyncInvoker _invoker;
+  std::shared_ptr<GameSocketPool> _gameSocketPool;
   std::queue<IceAdapterGameTask> _gameTasks;
   std::string _gpgnetGameState;
   std::map<int, std::shared_ptr<PeerRelay>> _relays;
+  std::shared_ptr<Gauge> _relayCount;
+  std::unique_ptr<MetricsServer> _metricsServer;
   std::string _gametaskString;
   webrtc::PeerConnectionInterface::IceServers _iceServers;
   std::string _lobbyInitMode;
@@ -12,7 +12,19 @@ IceAdapterOptions::IceAdapterOptions():
   rpcPort(7236),
   gpgNetPort(0),
   gameUdpPort(0),
-  logLevel("info")
+  gameSocketPoolSize(0),
+  bundlePackets(false),
+  bundleWindowUs(0),
+  reconnectBufferPackets(128),
+  reconnectBufferMs(1000),
+  negotiatedDataChannel(false),
+  rttProbeIntervalMs(1000),
+  rpcNotificationBatchMs(0),
+  logLevel("info"),
+  logBufferKb(1024),
+  logOverflow("drop"),
+  traceSizeMb(16),
+  metricsPort(0)
 {
 }
 
@@ -27,9 +39,24 @@ IceAdapterOptions IceAdapterOptions::init(int argc, char *argv[])
     ("login", "set the login of the local player, e.g. \"Rhiza\"", cxxopts::value<std::string>(result.localPlayerLogin))
     ("rpc-port", "set the port of internal JSON-RPC server", cxxopts::value<int>(result.rpcPort))
     ("gpgnet-port", "set the port of internal GPGNet server", cxxopts::value<int>(result.gpgNetPort))
+    ("rpc-socket", "additionally serve the JSON-RPC interface on this UNIX domain socket path (Linux only)", cxxopts::value<std::string>(result.rpcSocketPath))
+    ("gpgnet-socket", "additionally serve GPGNet on this UNIX domain socket path for local tools, the game itself needs TCP (Linux only)", cxxopts::value<std::string>(result.gpgNetSocketPath))
     ("lobby-port", "set the port the game lobby should use for incoming UDP packets from the PeerRelay. Set to 0 to use an automatic port.", cxxopts::value<int>(result.gameUdpPort))
+    ("game-socket-pool-size", "share this many UDP sockets between all peers for the game traffic (Linux only). Set to 0 to use one socket per peer.", cxxopts::value<int>(result.gameSocketPoolSize))
+    ("bundle-packets", "coalesce small game packets into one data channel message if the remote peer supports it", cxxopts::value<bool>(result.bundlePackets))
+    ("bundle-window-us", "time in microseconds to wait for more game packets to bundle. Set to 0 to bundle the packets of one read event.", cxxopts::value<int>(result.bundleWindowUs))
+    ("reconnect-buffer-packets", "number of game packets kept per peer while reconnecting. Set to 0 to drop them.", cxxopts::value<int>(result.reconnectBufferPackets))
+    ("reconnect-buffer-ms", "maximum age in milliseconds of a game packet kept while reconnecting", cxxopts::value<int>(result.reconnectBufferMs))
+    ("negotiated-datachannel", "create the data channel on both peers with a fixed stream id, saving the in-band open round trip. All remote peers must support it.", cxxopts::value<bool>(result.negotiatedDataChannel))
+    ("rtt-probe-interval-ms", "interval in milliseconds of the RTT probes sent while game data flows, skipped when a sample arrived within it. Set to 0 to only probe an idle link.", cxxopts::value<int>(result.rttProbeIntervalMs))
+    ("rpc-notification-batch-ms", "coalesce the JSON-RPC notifications sent within this many milliseconds into one batch. Set to 0 to send them immediately.", cxxopts::value<int>(result.rpcNotificationBatchMs))
     ("log-directory", "log to specified directory", cxxopts::value<std::string>(result.logDirectory))
     ("log-level", "set logging verbosity level: error, warn, info, verbose or debug", cxxopts::value<std::string>(result.logLevel))
+    ("log-buffer-kb", "size of the buffer the log is written from by a background thread. Set to 0 to write the log synchronously.", cxxopts::value<int>(result.logBufferKb))
+    ("log-overflow", "what to do when the log buffer is full: drop (count the dropped messages) or block", cxxopts::value<std::string>(result.logOverflow))
+    ("trace-file", "record relay lifecycle and packet events to this binary trace file (Linux only), convert it with faf-ice-trace2json", cxxopts::value<std::string>(result.traceFile))
+    ("trace-size-mb", "size of the trace file, the oldest events are overwritten when it is full", cxxopts::value<int>(result.traceSizeMb))
+    ("metrics-port", "serve metrics in the Prometheus text format at http://127.0.0.1:<port>/metrics. Set to 0 to disable.", cxxopts::value<int>(result.metricsPort))
     ;
 
   options.parse(argc, argv);
@@ -14,9 +14,24 @@ public:
   std::string localPlayerLogin; /*!< Login of the local player */
   int rpcPort;            /*!< Port of the internal JSON-RPC server to control the IceAdapter */
   int gpgNetPort;         /*!< Port of the internal GPGNet server to communicate with the game */
+  std::string rpcSocketPath;    /*!< optional AF_UNIX socket path the JSON-RPC server additionally listens on, default: "" - TCP only */
+  std::string gpgNetSocketPath; /*!< optional AF_UNIX socket path the GPGNet server additionally listens on, default: "" - TCP only */
   int gameUdpPort;        /*!< UDP port the game should use to communicate to the internal Relays */
+  int gameSocketPoolSize; /*!< number of UDP sockets shared by all Relays, default: 0 - one socket per Relay */
+  bool bundlePackets;     /*!< coalesce small game packets into one data channel message if the remote peer supports it */
+  int bundleWindowUs;     /*!< time to wait for more packets to bundle, default: 0 - bundle the packets of one read event */
+  int reconnectBufferPackets; /*!< game packets kept per Relay while reconnecting, default: 128 */
+  int reconnectBufferMs;  /*!< maximum age of a kept game packet, default: 1000 */
+  bool negotiatedDataChannel; /*!< create the data channel out-of-band on both peers instead of announcing it in-band */
+  int rttProbeIntervalMs; /*!< interval of RTT probes while game data flows, default: 1000, 0 - only probe an idle link */
+  int rpcNotificationBatchMs; /*!< window to coalesce outgoing JSON-RPC notifications into one batch, default: 0 - no batching */
   std::string logDirectory;    /*!< an optional file loggin directory, default: "" - no file log */
   std::string logLevel;   /*!< logging verbosity level, default: "debug"*/
+  int logBufferKb;        /*!< size of the ring buffer the log is written from in the background, default: 1024, 0 - log synchronously */
+  std::string logOverflow; /*!< what to do when the log buffer is full: "drop" or "block", default: "drop" */
+  std::string traceFile;  /*!< an optional binary event trace file, default: "" - no trace */
+  int traceSizeMb;        /*!< size of the event trace ring, default: 16 */
+  int metricsPort;        /*!< port of the local Prometheus metrics endpoint, default: 0 - disabled */
 
   /** \brief Create an options object from cmd arguments
       */
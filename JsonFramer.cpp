@@ -0,0 +1,168 @@
+#include "JsonFramer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "logging.h"
+
+namespace faf {
+
+JsonFramer::JsonFramer(std::size_t initialCapacity):
+  _buffer(initialCapacity)
+{
+}
+
+char* JsonFramer::prepare(std::size_t minSize)
+{
+  if (_buffer.size() - _end < minSize)
+  {
+    if (_begin > 0)
+    {
+      std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+      _scanPos -= _begin;
+      _end -= _begin;
+      _begin = 0;
+    }
+    if (_buffer.size() - _end < minSize)
+    {
+      _buffer.resize(std::max(2 * _buffer.size(), _end + minSize));
+    }
+  }
+  return _buffer.data() + _end;
+}
+
+void JsonFramer::commit(std::size_t size)
+{
+  _end += size;
+}
+
+void JsonFramer::append(const char* data, std::size_t size)
+{
+  std::memcpy(prepare(size), data, size);
+  commit(size);
+}
+
+bool JsonFramer::_scanNext()
+{
+  while (_scanPos < _end)
+  {
+    char c = _buffer[_scanPos];
+    ++_scanPos;
+    if (_depth == 0)
+    {
+      /* between messages */
+      if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+      {
+        _begin = _scanPos;
+        continue;
+      }
+      if (c == '\0')
+      {
+        return _scanBinary();
+      }
+      if (c != '{' &&
+          c != '[')
+      {
+        FAF_LOG_ERROR << "invalid JSON msg";
+        _reset();
+        return false;
+      }
+      _depth = 1;
+      continue;
+    }
+    if (_inString)
+    {
+      if (_escape)
+      {
+        _escape = false;
+      }
+      else if (c == '\\')
+      {
+        _escape = true;
+      }
+      else if (c == '"')
+      {
+        _inString = false;
+      }
+      continue;
+    }
+    switch (c)
+    {
+      case '"':
+        _inString = true;
+        break;
+      case '{':
+      case '[':
+        ++_depth;
+        break;
+      case '}':
+      case ']':
+        --_depth;
+        if (_depth == 0)
+        {
+          return true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  if (_depth == 0)
+  {
+    /* only whitespace left */
+    _begin = _scanPos = _end = 0;
+  }
+  return false;
+}
+
+bool JsonFramer::_scanBinary()
+{
+  /* _begin points to the size prefix */
+  if (_end - _begin < binaryHeaderSize)
+  {
+    _scanPos = _begin;
+    return false;
+  }
+  auto header = reinterpret_cast<const unsigned char*>(_buffer.data() + _begin);
+  std::size_t size = (std::size_t(header[1]) << 16) |
+                     (std::size_t(header[2]) << 8) |
+                     std::size_t(header[3]);
+  if (_end - _begin < binaryHeaderSize + size)
+  {
+    _scanPos = _begin;
+    return false;
+  }
+  _scanPos = _begin + binaryHeaderSize + size;
+  _binary = true;
+  return true;
+}
+
+void JsonFramer::writeBinaryHeader(char* header, std::size_t size)
+{
+  header[0] = 0;
+  header[1] = static_cast<char>((size >> 16) & 0xff);
+  header[2] = static_cast<char>((size >> 8) & 0xff);
+  header[3] = static_cast<char>(size & 0xff);
+}
+
+void JsonFramer::_consumeMessage()
+{
+  _binary = false;
+  _begin = _scanPos;
+  if (_begin == _end)
+  {
+    _begin = _scanPos = _end = 0;
+  }
+}
+
+void JsonFramer::_reset()
+{
+  ++_errors;
+  _begin = _scanPos = _end = 0;
+  _depth = 0;
+  _inString = false;
+  _escape = false;
+  _binary = false;
+}
+
+} // namespace faf
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace faf {
+
+/*! \brief Splits a stream of concatenated JSON objects or batch arrays into single messages
+ *
+ *  The data is received directly into the framer buffer via prepare() and
+ *  commit(). The brace/string scan state is kept between reads, so every
+ *  byte is scanned only once regardless of how the stream is split. The
+ *  framed messages are handed out as ranges into the buffer to be parsed in
+ *  place.
+ *
+ *  Binary messages may be interleaved with the JSON text. They are prefixed
+ *  with their size as 24 bit big endian integer after a zero byte, which can
+ *  never start a JSON message.
+ */
+class JsonFramer
+{
+public:
+  explicit JsonFramer(std::size_t initialCapacity = 4096);
+
+  /** \brief Get a write pointer with at least minSize writable bytes
+      */
+  char* prepare(std::size_t minSize);
+
+  /** \brief Mark size bytes written to the pointer returned by prepare() as received
+      */
+  void commit(std::size_t size);
+
+  void append(const char* data, std::size_t size);
+
+  /** \brief Call cb(const char* begin, const char* end, bool binary) for every complete message in the buffer
+      */
+  template<class Callback>
+  void parse(Callback&& cb)
+  {
+    while (_scanNext())
+    {
+      if (_binary)
+      {
+        cb(_buffer.data() + _begin + binaryHeaderSize, _buffer.data() + _scanPos, true);
+      }
+      else
+      {
+        cb(_buffer.data() + _begin, _buffer.data() + _scanPos, false);
+      }
+      _consumeMessage();
+    }
+  }
+
+  static constexpr const std::size_t binaryHeaderSize = 4;
+  static constexpr const std::size_t maxBinarySize = 0xffffff;
+
+  /** \brief Write the binaryHeaderSize bytes prefix of a binary message of size bytes
+      */
+  static void writeBinaryHeader(char* header, std::size_t size);
+
+  std::size_t bufferedSize() const
+  {
+    return _end - _begin;
+  }
+
+  /** \brief The number of times the buffer was dropped because of invalid data
+      */
+  uint64_t errors() const
+  {
+    return _errors;
+  }
+
+protected:
+  bool _scanNext();
+  bool _scanBinary();
+  void _consumeMessage();
+  void _reset();
+
+  std::vector<char> _buffer;
+  std::size_t _begin{0};    /*!< start of the current message */
+  std::size_t _scanPos{0};  /*!< end of the scanned part of the current message */
+  std::size_t _end{0};      /*!< end of the received data */
+
+  int _depth{0};
+  bool _inString{false};
+  bool _escape{false};
+  bool _binary{false};
+  uint64_t _errors{0};
+};
+
+} // namespace faf
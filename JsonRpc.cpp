@@ -1,13 +1,40 @@
 #include "JsonRpc.h"
 
+#include <algorithm>
+
+#include "CborCodec.h"
 #include "logging.h"
-#include "trim.h"
 
 namespace faf {
 
 JsonRpc::JsonRpc():
   _currentId(0)
 {
+  setRpcCallback("setEncoding",
+                 [this](Json::Value const& paramsArray,
+                        Json::Value & result,
+                        Json::Value & error,
+                        rtc::AsyncSocket* socket)
+  {
+    Encoding encoding;
+    if (paramsArray.size() < 1 ||
+        !paramsArray[0].isString() ||
+        !encodingFromName(paramsArray[0].asString(), encoding))
+    {
+      error = "Need 1 parameter: encoding (string): json or cbor";
+      return;
+    }
+    /* the response is already sent in the new encoding */
+    if (encoding == Encoding::Json)
+    {
+      _encodings.erase(socket);
+    }
+    else
+    {
+      _encodings[socket] = encoding;
+    }
+    result = encodingName(encoding);
+  });
 }
 
 JsonRpc::~JsonRpc()
@@ -18,12 +45,27 @@ void JsonRpc::setRpcCallback(std::string const& method,
                              RpcCallback cb)
 {
   _callbacks[method] = cb;
+  _registerMethodMetrics(method);
 }
 
 void JsonRpc::setRpcCallbackAsync(std::string const& method,
                                   RpcCallbackAsync cb)
 {
   _callbacksAsync[method] = cb;
+  _registerMethodMetrics(method);
+}
+
+void JsonRpc::_registerMethodMetrics(std::string const& method)
+{
+  auto& registry = MetricsRegistry::global();
+  auto labels = MetricsRegistry::labels({{"method", method}});
+  MethodMetrics& metrics = _methodMetrics[method];
+  metrics.calls = registry.counter("faf_rpc_calls_total", "JSON-RPC requests handled", labels);
+  metrics.errors = registry.counter("faf_rpc_errors_total", "JSON-RPC requests answered with an error", labels);
+  metrics.duration = registry.histogram("faf_rpc_call_duration_seconds",
+                                        "Time from receiving a JSON-RPC request to its response",
+                                        MetricsRegistry::latencyBuckets(),
+                                        labels);
 }
 
 void JsonRpc::sendRequest(std::string const& method,
@@ -56,101 +98,295 @@ void JsonRpc::sendRequest(std::string const& method,
   request["jsonrpc"] = "2.0";
   request["method"] = method;
   request["params"] = paramsArray;
+  int id = _currentId;
   if (resultCb)
   {
-    _currentRequests[_currentId] = resultCb;
-    request["id"] = _currentId;
+    auto now = Clock::now();
+    _currentRequests[id] = PendingRequest{resultCb, socket, now};
+    _requestDeadlines.emplace(now + _requestTimeout, id);
+    _armRequestTimer();
+    request["id"] = id;
     ++_currentId;
   }
-  std::string requestString = Json::FastWriter().write(request);
+  if (!resultCb &&
+      _notificationBatchWindowMs > 0)
+  {
+    _pendingNotifications.emplace_back(socket, request);
+    if (!_notificationFlushTimer.started())
+    {
+      _notificationFlushTimer.start(_notificationBatchWindowMs, std::bind(&JsonRpc::_flushNotifications, this));
+    }
+    return;
+  }
 
-  if (!_sendMessage(requestString, socket))
+  if (!_send(request, socket))
   {
     Json::Value error = "send failed";
     if (resultCb)
     {
+      _currentRequests.erase(id);
       resultCb(Json::Value(),
                error);
     }
   }
 }
 
-Json::Value JsonRpc::_parseJsonFromMsgBuffer(std::string& msgBuffer)
+void JsonRpc::setRequestTimeout(int timeoutMs)
+{
+  _requestTimeout = std::chrono::milliseconds(timeoutMs);
+}
+
+Json::Value JsonRpc::pendingRequestsStatus() const
 {
-  //FAF_LOG_TRACE << "parsing JSON string: " << msgBuffer;
   Json::Value result;
+  result["pending"] = Json::UInt64(_currentRequests.size());
+  result["oldest_pending_age_ms"] = 0;
+  if (!_currentRequests.empty())
+  {
+    auto age = Clock::now() - _currentRequests.begin()->second.sent;
+    result["oldest_pending_age_ms"] = Json::Int64(std::chrono::duration_cast<std::chrono::milliseconds>(age).count());
+  }
+  result["timed_out"] = Json::UInt64(_timedOutRequests);
+  result["failed"] = Json::UInt64(_failedRequests);
+  return result;
+}
 
-  if (msgBuffer.empty())
+void JsonRpc::_armRequestTimer()
+{
+  while (!_requestDeadlines.empty() &&
+         _currentRequests.find(_requestDeadlines.top().second) == _currentRequests.end())
   {
-    return result;
+    _requestDeadlines.pop();
+  }
+  if (_requestDeadlines.empty())
+  {
+    _requestTimer.stop();
+    return;
   }
-  if (msgBuffer.at(0) != '{')
+  auto deadline = _requestDeadlines.top().first;
+  if (_requestTimer.started() &&
+      _requestTimerDeadline <= deadline)
   {
-    msgBuffer.clear();
-    FAF_LOG_ERROR << "invalid JSON msg";
-    return result;
+    return;
   }
+  _requestTimerDeadline = deadline;
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+  _requestTimer.start(static_cast<int>(std::max<decltype(delay)>(delay, 0)) + 1,
+                      std::bind(&JsonRpc::_expireRequests, this));
+}
 
-  bool inString = false;
-  int braceNestingLevel = 0;
-  std::size_t msgPos = 0;
+void JsonRpc::_expireRequests()
+{
+  _requestTimer.stop();
+  auto now = Clock::now();
+  std::vector<RpcRequestResult> expired;
+  while (!_requestDeadlines.empty() &&
+         _requestDeadlines.top().first <= now)
+  {
+    auto it = _currentRequests.find(_requestDeadlines.top().second);
+    _requestDeadlines.pop();
+    if (it != _currentRequests.end())
+    {
+      FAF_LOG_WARN << "JSON-RPC request " << it->first << " timed out";
+      expired.push_back(std::move(it->second.callback));
+      _currentRequests.erase(it);
+    }
+  }
+  _timedOutRequests += expired.size();
+  _armRequestTimer();
+  /* the callbacks may send new requests */
+  for (auto& callback : expired)
+  {
+    try
+    {
+      callback(Json::Value(), Json::Value("request timed out"));
+    }
+    catch (std::exception& e)
+    {
+      FAF_LOG_ERROR << "exception in request handler: " << e.what();
+    }
+  }
+}
 
-  for (; msgPos < msgBuffer.size(); ++msgPos)
+void JsonRpc::_failPendingRequests(rtc::AsyncSocket* socket, std::string const& error)
+{
+  std::vector<RpcRequestResult> failed;
+  for (auto it = _currentRequests.begin(); it != _currentRequests.end();)
   {
-    const char& c = msgBuffer.at(msgPos);
-    if (c == '"')
+    if (!socket ||
+        it->second.socket == socket)
     {
-      inString = !inString;
+      failed.push_back(std::move(it->second.callback));
+      it = _currentRequests.erase(it);
     }
+    else
+    {
+      ++it;
+    }
+  }
+  _failedRequests += failed.size();
+  _armRequestTimer();
+  for (auto& callback : failed)
+  {
+    try
+    {
+      callback(Json::Value(), Json::Value(error));
+    }
+    catch (std::exception& e)
+    {
+      FAF_LOG_ERROR << "exception in request handler: " << e.what();
+    }
+  }
+}
+
+const char* JsonRpc::encodingName(Encoding encoding)
+{
+  switch (encoding)
+  {
+    case Encoding::Cbor:
+      return "cbor";
+    case Encoding::Json:
+    default:
+      return "json";
+  }
+}
 
-    if (!inString)
+bool JsonRpc::encodingFromName(std::string const& name, Encoding& encoding)
+{
+  if (name == "json")
+  {
+    encoding = Encoding::Json;
+    return true;
+  }
+  if (name == "cbor")
+  {
+    encoding = Encoding::Cbor;
+    return true;
+  }
+  return false;
+}
+
+void JsonRpc::requestEncoding(Encoding encoding,
+                              rtc::AsyncSocket* socket,
+                              RpcRequestResult resultCb)
+{
+  Json::Value params(Json::arrayValue);
+  params.append(encodingName(encoding));
+  sendRequest("setEncoding",
+              params,
+              socket,
+              [this, encoding, socket, resultCb](Json::Value const& result, Json::Value const& error)
+  {
+    if (error.isNull())
     {
-      if (c == '{')
+      if (encoding == Encoding::Json)
       {
-        ++braceNestingLevel;
+        _encodings.erase(socket);
       }
-
-      if (c == '}')
+      else
       {
-        --braceNestingLevel;
-        if (braceNestingLevel < 0)
-        {
-          msgBuffer.clear();
-          FAF_LOG_ERROR << "invalid JSON msg";
-          return result;
-        }
+        _encodings[socket] = encoding;
+      }
+    }
+    if (resultCb)
+    {
+      resultCb(result, error);
+    }
+  });
+}
 
-        /* parse msg */
-        if (braceNestingLevel == 0)
-        {
-          Json::Reader reader;
-          if (!reader.parse(std::string(msgBuffer.cbegin(),
-                                        msgBuffer.cbegin() + static_cast<std::string::difference_type>(msgPos + 1)),
-                            result))
-          {
-            FAF_LOG_ERROR << "error parsing JSON msg: " << reader.getFormatedErrorMessages();
-            msgBuffer.clear();
-            return result;
-          }
-          if (msgPos + 1 >= msgBuffer.size())
-          {
-            msgBuffer.clear();
-          }
-          else
-          {
-            msgBuffer = msgBuffer.substr(msgPos + 1);
-          }
-          return result;
-        }
+JsonRpc::Encoding JsonRpc::_encoding(rtc::AsyncSocket* socket) const
+{
+  auto it = _encodings.find(socket);
+  if (it != _encodings.end())
+  {
+    return it->second;
+  }
+  return Encoding::Json;
+}
+
+std::string JsonRpc::_encode(Json::Value const& message, Encoding encoding)
+{
+  if (encoding == Encoding::Cbor)
+  {
+    std::string result(JsonFramer::binaryHeaderSize, '\0');
+    CborCodec::encode(message, result);
+    std::size_t size = result.size() - JsonFramer::binaryHeaderSize;
+    if (size <= JsonFramer::maxBinarySize)
+    {
+      JsonFramer::writeBinaryHeader(&result[0], size);
+      return result;
+    }
+    /* too large for the size prefix, the peer accepts JSON anyway */
+  }
+  return Json::FastWriter().write(message);
+}
+
+void JsonRpc::setNotificationBatchWindow(int windowMs)
+{
+  _notificationBatchWindowMs = windowMs;
+  if (_notificationBatchWindowMs <= 0)
+  {
+    _flushNotifications();
+  }
+}
+
+bool JsonRpc::_send(Json::Value const& message, rtc::AsyncSocket* socket)
+{
+  /* keep the order of the messages */
+  _flushNotifications();
+  return _sendMessage(message, socket);
+}
+
+void JsonRpc::_flushNotifications()
+{
+  _notificationFlushTimer.stop();
+  if (_pendingNotifications.empty())
+  {
+    return;
+  }
+  auto pending = std::move(_pendingNotifications);
+  _pendingNotifications.clear();
+  /* one batch per run of notifications to the same target */
+  for (std::size_t begin = 0; begin < pending.size();)
+  {
+    std::size_t end = begin + 1;
+    while (end < pending.size() &&
+           pending[end].first == pending[begin].first)
+    {
+      ++end;
+    }
+    Json::Value message;
+    if (end - begin == 1)
+    {
+      message = pending[begin].second;
+    }
+    else
+    {
+      message = Json::Value(Json::arrayValue);
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        message.append(pending[i].second);
       }
     }
+    _sendMessage(message, pending[begin].first);
+    begin = end;
   }
-  return result;
 }
 
 void JsonRpc::_processJsonMessage(Json::Value const& jsonMessage, rtc::AsyncSocket* socket)
 {
   //FAF_LOG_TRACE << "processing JSON msg: " << jsonMessage.toStyledString();
+  if (jsonMessage.isArray())
+  {
+    _processBatch(jsonMessage, socket);
+    return;
+  }
+  if (!jsonMessage.isObject())
+  {
+    FAF_LOG_ERROR << "invalid JSON-RPC message";
+    return;
+  }
   if (jsonMessage.isMember("method"))
   {
     /* this message is a request */
@@ -159,9 +395,7 @@ void JsonRpc::_processJsonMessage(Json::Value const& jsonMessage, rtc::AsyncSock
           /* we don't need to respond to notifications */
           if (jsonMessage.isMember("id"))
           {
-            std::string responseString = Json::FastWriter().write(response);
-            //FAF_LOG_TRACE << "sending response:" << responseString;
-            _sendMessage(responseString, socket);
+            _send(response, socket);
           }
         },
         socket);
@@ -169,24 +403,104 @@ void JsonRpc::_processJsonMessage(Json::Value const& jsonMessage, rtc::AsyncSock
   else if (jsonMessage.isMember("error") ||
            jsonMessage.isMember("result"))
   {
-    /* this message is a response */
-    if (jsonMessage.isMember("id"))
+    _processResponse(jsonMessage);
+  }
+}
+
+void JsonRpc::_processBatch(Json::Value const& batch, rtc::AsyncSocket* socket)
+{
+  if (batch.empty())
+  {
+    Json::Value response;
+    response["jsonrpc"] = "2.0";
+    response["id"] = Json::Value();
+    response["error"]["code"] = -32600;
+    response["error"]["message"] = "empty batch";
+    _send(response, socket);
+    return;
+  }
+
+  /* The responses are sent as one batch once all requests of the batch are answered.
+   * pending starts at 1 so synchronous callbacks can't complete the batch while it is processed. */
+  struct BatchResponse
+  {
+    Json::Value responses{Json::arrayValue};
+    std::size_t pending{1};
+  };
+  auto batchResponse = std::make_shared<BatchResponse>();
+  auto sendIfComplete = [this, batchResponse, socket]()
+  {
+    if (batchResponse->pending == 0 &&
+        !batchResponse->responses.empty())
+    {
+      _send(batchResponse->responses, socket);
+    }
+  };
+
+  for (auto const& message : batch)
+  {
+    if (!message.isObject())
     {
-      if (jsonMessage["id"].isInt())
+      Json::Value response;
+      response["jsonrpc"] = "2.0";
+      response["id"] = Json::Value();
+      response["error"]["code"] = -32600;
+      response["error"]["message"] = "batch element must be an object";
+      batchResponse->responses.append(response);
+    }
+    else if (message.isMember("method"))
+    {
+      if (!message.isMember("id"))
       {
-        auto reqIt = _currentRequests.find(jsonMessage["id"].asInt());
-        if (reqIt != _currentRequests.end())
+        /* notification */
+        _processRequest(message, [](Json::Value) {}, socket);
+        continue;
+      }
+      ++batchResponse->pending;
+      auto answered = std::make_shared<bool>(false);
+      _processRequest(message, [batchResponse, sendIfComplete, answered](Json::Value response)
+      {
+        if (*answered)
         {
-          try
-          {
-            reqIt->second(jsonMessage.isMember("result") ? jsonMessage["result"] : Json::Value(),
-                          jsonMessage.isMember("error") ? jsonMessage["error"] : Json::Value());
-          }
-          catch (std::exception& e)
-          {
-            FAF_LOG_ERROR << "exception in request handler for id " << jsonMessage["id"].asInt() << ": " << e.what();
-          }
+          return;
+        }
+        *answered = true;
+        batchResponse->responses.append(response);
+        --batchResponse->pending;
+        sendIfComplete();
+      },
+      socket);
+    }
+    else if (message.isMember("error") ||
+             message.isMember("result"))
+    {
+      _processResponse(message);
+    }
+  }
+  --batchResponse->pending;
+  sendIfComplete();
+}
+
+void JsonRpc::_processResponse(Json::Value const& response)
+{
+  if (response.isMember("id"))
+  {
+    if (response["id"].isInt())
+    {
+      auto reqIt = _currentRequests.find(response["id"].asInt());
+      if (reqIt != _currentRequests.end())
+      {
+        try
+        {
+          /* remove the request first, the callback may send new requests */
+          auto callback = std::move(reqIt->second.callback);
           _currentRequests.erase(reqIt);
+          callback(response.isMember("result") ? response["result"] : Json::Value(),
+                   response.isMember("error") ? response["error"] : Json::Value());
+        }
+        catch (std::exception& e)
+        {
+          FAF_LOG_ERROR << "exception in request handler for id " << response["id"].asInt() << ": " << e.what();
         }
       }
     }
@@ -219,6 +533,23 @@ void JsonRpc::_processRequest(Json::Value const& request, ResponseCallback respo
 
   //FAF_LOG_TRACE << "dispatching JSRONRPC method '" << request["method"].asString() << "'";
 
+  auto metricsIt = _methodMetrics.find(request["method"].asString());
+  if (metricsIt != _methodMetrics.end())
+  {
+    /* async methods are measured until they answer */
+    MethodMetrics metrics = metricsIt->second;
+    metrics.calls->inc();
+    responseCallback = [responseCallback, metrics, start = Clock::now()](Json::Value response)
+    {
+      metrics.duration->observe(std::chrono::duration<double>(Clock::now() - start).count());
+      if (response.isMember("error"))
+      {
+        metrics.errors->inc();
+      }
+      responseCallback(response);
+    };
+  }
+
   Json::Value params(Json::arrayValue);
   if (request.isMember("params") &&
       request["params"].isArray())
@@ -254,6 +585,8 @@ void JsonRpc::_processRequest(Json::Value const& request, ResponseCallback respo
     catch (std::exception& e)
     {
       FAF_LOG_ERROR << "exception in callback for method '" << request["method"].asString() << "': " << e.what();
+      response["error"] = std::string("exception in callback: ") + e.what();
+      responseCallback(response);
     }
   }
   else
@@ -281,6 +614,8 @@ void JsonRpc::_processRequest(Json::Value const& request, ResponseCallback respo
       catch (std::exception& e)
       {
         FAF_LOG_ERROR << "exception in callback for method '" << request["method"].asString() << "': " << e.what();
+        response["error"] = std::string("exception in callback: ") + e.what();
+        responseCallback(response);
       }
     }
     else
@@ -295,30 +630,38 @@ void JsonRpc::_processRequest(Json::Value const& request, ResponseCallback respo
 void JsonRpc::_read(rtc::AsyncSocket* socket)
 {
   int msgLength = 0;
-  std::string& msgBuffer = _currentMsgs[socket];
+  JsonFramer& framer = _currentMsgs[socket];
   do
   {
-    msgLength = socket->Recv(_readBuffer.data(), _readBuffer.size(), nullptr);
+    msgLength = socket->Recv(framer.prepare(readSize), readSize, nullptr);
     if (msgLength > 0)
     {
-      msgBuffer.append(_readBuffer.data(), std::size_t(msgLength));
+      framer.commit(std::size_t(msgLength));
     }
   }
   while (msgLength > 0);
-  while (true)
+  framer.parse([this, socket](const char* begin, const char* end, bool binary)
   {
-    msgBuffer = trim_whitespace(msgBuffer);
-    if (msgBuffer.empty())
+    Json::Value json;
+    if (binary)
     {
-      break;
+      if (!CborCodec::decode(begin, end, json))
+      {
+        FAF_LOG_ERROR << "error parsing CBOR msg";
+        return;
+      }
     }
-    Json::Value json = _parseJsonFromMsgBuffer(msgBuffer);
-    if (json.isNull())
+    else
     {
-      break;
+      Json::Reader reader;
+      if (!reader.parse(begin, end, json, false))
+      {
+        FAF_LOG_ERROR << "error parsing JSON msg: " << reader.getFormatedErrorMessages();
+        return;
+      }
     }
     _processJsonMessage(json, socket);
-  }
+  });
 }
 
 } // namespace faf
@@ -1,13 +1,19 @@
 #pragma once
 
-#include <array>
+#include <chrono>
 #include <memory>
 #include <map>
 #include <functional>
+#include <queue>
+#include <vector>
 
 #include <webrtc/rtc_base/asyncsocket.h>
 #include <third_party/json/json.h>
 
+#include "JsonFramer.h"
+#include "Metrics.h"
+#include "Timer.h"
+
 namespace faf {
 
 class JsonRpc
@@ -38,20 +44,96 @@ public:
                    rtc::AsyncSocket* socket = nullptr,
                    RpcRequestResult resultCb = RpcRequestResult());
 
+  /*! \brief The encoding of the messages sent to a socket
+   *
+   *  Received messages are always accepted in any encoding.
+   */
+  enum class Encoding
+  {
+    Json,
+    Cbor   /*!< length prefixed CBOR, see JsonFramer */
+  };
+  static const char* encodingName(Encoding encoding);
+  static bool encodingFromName(std::string const& name, Encoding& encoding);
+
+  /** \brief Ask the peer to send its messages to socket in the specified encoding
+       The own messages to socket are switched once the peer has confirmed the request.
+      */
+  void requestEncoding(Encoding encoding,
+                       rtc::AsyncSocket* socket,
+                       RpcRequestResult resultCb = RpcRequestResult());
+
+  /** \brief Complete the requests not answered within timeoutMs with an error
+      */
+  void setRequestTimeout(int timeoutMs);
+
+  /** \brief The number of unanswered requests and the age of the oldest one
+      */
+  Json::Value pendingRequestsStatus() const;
+
+  /** \brief Coalesce the notifications sent within windowMs into one JSON-RPC batch
+       \param windowMs: The flush window, 0 to send each notification immediately
+      */
+  void setNotificationBatchWindow(int windowMs);
+
 protected:
   void _read(rtc::AsyncSocket* socket);
-  Json::Value _parseJsonFromMsgBuffer(std::string& msgBuffer);
   void _processJsonMessage(Json::Value const& jsonMessage, rtc::AsyncSocket* socket);
+  void _processBatch(Json::Value const& batch, rtc::AsyncSocket* socket);
+  void _processResponse(Json::Value const& response);
+  bool _send(Json::Value const& message, rtc::AsyncSocket* socket);
+  void _flushNotifications();
+  void _expireRequests();
+  void _armRequestTimer();
+  /* complete the pending requests sent to socket, or all for nullptr, with error */
+  void _failPendingRequests(rtc::AsyncSocket* socket, std::string const& error);
   void _processRequest(Json::Value const& request, ResponseCallback response, rtc::AsyncSocket* socket);
 
-  virtual bool _sendMessage(std::string const& message, rtc::AsyncSocket* socket) = 0;
+  virtual bool _sendMessage(Json::Value const& message, rtc::AsyncSocket* socket) = 0;
 
-  std::array<char, 2048> _readBuffer;
-  std::map<rtc::AsyncSocket*, std::string> _currentMsgs;
-  std::map<int, RpcRequestResult> _currentRequests;
+  Encoding _encoding(rtc::AsyncSocket* socket) const;
+  static std::string _encode(Json::Value const& message, Encoding encoding);
+
+  static constexpr const std::size_t readSize = 2048;
+  /* the incomplete received messages of each socket */
+  std::map<rtc::AsyncSocket*, JsonFramer> _currentMsgs;
+  using Clock = std::chrono::steady_clock;
+  struct PendingRequest
+  {
+    RpcRequestResult callback;
+    rtc::AsyncSocket* socket;
+    Clock::time_point sent;
+  };
+  /* ordered by id, so the first one is the oldest */
+  std::map<int, PendingRequest> _currentRequests;
+  /* min-heap of the request deadlines, answered requests are skipped when they come up */
+  std::priority_queue<std::pair<Clock::time_point, int>,
+                      std::vector<std::pair<Clock::time_point, int>>,
+                      std::greater<std::pair<Clock::time_point, int>>> _requestDeadlines;
+  std::chrono::milliseconds _requestTimeout{30000};
+  Timer _requestTimer;
+  Clock::time_point _requestTimerDeadline;
+  uint64_t _timedOutRequests{0};
+  uint64_t _failedRequests{0};
   std::map<std::string, RpcCallback> _callbacks;
   std::map<std::string, RpcCallbackAsync> _callbacksAsync;
+  /* metrics of the registered methods, unknown methods aren't counted */
+  struct MethodMetrics
+  {
+    std::shared_ptr<Counter> calls;
+    std::shared_ptr<Counter> errors;
+    std::shared_ptr<Histogram> duration;
+  };
+  void _registerMethodMetrics(std::string const& method);
+  std::map<std::string, MethodMetrics> _methodMetrics;
   int _currentId;
+  /* the encodings of the sockets not using JSON */
+  std::map<rtc::AsyncSocket*, Encoding> _encodings;
+
+  /* notifications waiting for the batch flush window */
+  int _notificationBatchWindowMs{0};
+  std::vector<std::pair<rtc::AsyncSocket*, Json::Value>> _pendingNotifications;
+  Timer _notificationFlushTimer;
 
 };
 
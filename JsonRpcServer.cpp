@@ -1,5 +1,7 @@
 #include "JsonRpcServer.h"
 
+#include <algorithm>
+
 #if defined(WEBRTC_POSIX)
 #  include <sys/socket.h>
 #  include <netinet/in.h>
@@ -10,6 +12,7 @@
 #include <webrtc/rtc_base/thread.h>
 
 #include "logging.h"
+#include "UnixSocket.h"
 
 namespace faf {
 
@@ -20,6 +23,13 @@ JsonRpcServer::JsonRpcServer():
 
 JsonRpcServer::~JsonRpcServer()
 {
+  /* the deferred removal of closed clients */
+  rtc::Thread::Current()->Clear(this);
+  if (_unixServer)
+  {
+    _unixServer->Close();
+    unix_socket_unlink(_unixSocketPath);
+  }
 }
 
 void JsonRpcServer::listen(int port, std::string const& hostname)
@@ -34,18 +44,64 @@ void JsonRpcServer::listen(int port, std::string const& hostname)
   FAF_LOG_INFO << "JsonRpcServer listening on " << hostname << ":" << _server->GetLocalAddress().port();
 }
 
+void JsonRpcServer::listenUnix(std::string const& path)
+{
+  _unixServer.reset(unix_socket_listen(path));
+  if (!_unixServer)
+  {
+    FAF_LOG_ERROR << "unable to listen on UNIX socket " << path;
+    std::exit(1);
+  }
+  _unixSocketPath = path;
+  _unixServer->SignalReadEvent.connect(this, &JsonRpcServer::_onNewClient);
+  FAF_LOG_INFO << "JsonRpcServer listening on " << path;
+}
+
 int JsonRpcServer::listenPort() const
 {
   return _server->GetLocalAddress().port();
 }
 
+void JsonRpcServer::setMergeableNotification(std::string const& method, int keyParams)
+{
+  _mergeableNotifications[method] = keyParams;
+}
+
+Json::Value JsonRpcServer::writeQueueStatus() const
+{
+  SocketWriteQueueStats stats;
+  std::size_t heldNotifications = 0;
+  for (auto const& entry : _clients)
+  {
+    stats.add(*entry.second.writeQueue);
+    heldNotifications += entry.second.heldNotifications.size();
+  }
+  Json::Value result = stats.toJson();
+  result["held_notifications"] = Json::UInt64(heldNotifications);
+  result["merged_notifications"] = Json::UInt64(_mergedNotifications);
+  result["dropped_clients"] = Json::UInt64(_droppedClients);
+  return result;
+}
+
 void JsonRpcServer::_onNewClient(rtc::AsyncSocket* socket)
 {
   rtc::SocketAddress accept_addr;
-  auto newConnectedSocket = std::shared_ptr<rtc::AsyncSocket>(_server->Accept(&accept_addr));
+  auto newConnectedSocket = std::shared_ptr<rtc::AsyncSocket>(socket->Accept(&accept_addr));
+  if (!newConnectedSocket)
+  {
+    return;
+  }
 #if defined(WEBRTC_POSIX)
-  int fd = static_cast<rtc::SocketDispatcher*>(newConnectedSocket.get())->GetDescriptor();
-  if (fd)
+  /* only TCP connections need the keepalive,
+   * the descriptor is only known for sockets of a PhysicalSocketServer */
+  auto dispatcher = dynamic_cast<rtc::SocketDispatcher*>(newConnectedSocket.get());
+  int fd = dispatcher ? dispatcher->GetDescriptor() : -1;
+  if (socket == _server.get() &&
+      fd < 0)
+  {
+    FAF_LOG_WARN << "JsonRpcServer: unable to enable the keepalive of the client socket";
+  }
+  else if (socket == _server.get())
   {
     int keepalive = 1;
     int keepcnt = 1;
@@ -59,57 +115,223 @@ void JsonRpcServer::_onNewClient(rtc::AsyncSocket* socket)
 #endif
   newConnectedSocket->SignalReadEvent.connect(this, &JsonRpcServer::_onRead);
   newConnectedSocket->SignalCloseEvent.connect(this, &JsonRpcServer::_onClientDisconnect);
-  _connectedSockets.insert(std::make_pair(newConnectedSocket.get(), newConnectedSocket));
+  Client& client = _clients[newConnectedSocket.get()];
+  client.socket = newConnectedSocket;
+  client.writeQueue = std::make_unique<SocketWriteQueue>(newConnectedSocket.get());
+  client.writeQueue->SignalDrained.connect(this, &JsonRpcServer::_onClientDrained);
   FAF_LOG_DEBUG << "JsonRpcServer client connected from " << accept_addr;
   SignalClientConnected.emit(newConnectedSocket.get());
 }
 
 void JsonRpcServer::_onClientDisconnect(rtc::AsyncSocket* socket, int _whatsThis_)
 {
-  _currentMsgs.erase(socket);
-  _connectedSockets.erase(socket);
+  _removeClient(socket);
   FAF_LOG_DEBUG << "JsonRpcServer client disonnected: " << _whatsThis_;
   SignalClientDisconnected.emit(socket);
 }
 
+void JsonRpcServer::_onClientDrained(SocketWriteQueue* queue)
+{
+  auto it = _clients.find(queue->socket());
+  if (it == _clients.end())
+  {
+    return;
+  }
+  Client& client = it->second;
+  auto heldNotifications = std::move(client.heldNotifications);
+  client.heldNotifications.clear();
+  for (auto const& notification : heldNotifications)
+  {
+    if (client.closing)
+    {
+      break;
+    }
+    std::map<Encoding, std::string> encodedMessages;
+    _queueMessage(client, notification.second, encodedMessages);
+  }
+}
+
 void JsonRpcServer::_onRead(rtc::AsyncSocket* socket)
 {
-  if (_connectedSockets.find(socket) != _connectedSockets.end())
+  if (_clients.find(socket) != _clients.end())
   {
     JsonRpc::_read(socket);
   }
 }
 
-bool JsonRpcServer::_sendMessage(std::string const& message, rtc::AsyncSocket* socket)
+bool JsonRpcServer::_sendMessage(Json::Value const& message, rtc::AsyncSocket* socket)
 {
-  if (_connectedSockets.empty())
+  if (_clients.empty())
   {
     FAF_LOG_ERROR << "mSessions.empty()";
     return false;
   }
-  for (auto it = _connectedSockets.begin(), end = _connectedSockets.end(); it != end; ++it)
+  std::string mergeKey = _mergeKey(message);
+  /* encode once per encoding used by the receivers */
+  std::map<Encoding, std::string> encodedMessages;
+  for (auto& entry : _clients)
   {
-    if (socket)
+    Client& client = entry.second;
+    if ((socket && entry.first != socket) ||
+        client.closing)
     {
-      if (it->second.get() != socket)
-      {
-        continue;
-      }
+      continue;
     }
     //FAF_LOG_TRACE << "sending " << message;
 
-    if (!it->second->Send(message.c_str(), message.size()))
+    if (client.writeQueue->waitingForWrite())
     {
-      _currentMsgs.erase(it->second.get());
-      it = _connectedSockets.erase(it);
-      FAF_LOG_ERROR << "sending " << message << " failed";
+      if (!mergeKey.empty())
+      {
+        _holdNotification(client, mergeKey, message);
+        continue;
+      }
+      if (message.isArray())
+      {
+        /* a batch of notifications, hold back its mergeable ones and queue the rest */
+        Json::Value rest(Json::arrayValue);
+        for (auto const& element : message)
+        {
+          auto elementKey = _mergeKey(element);
+          if (elementKey.empty())
+          {
+            rest.append(element);
+          }
+          else
+          {
+            _holdNotification(client, elementKey, element);
+          }
+        }
+        if (rest.size() < message.size())
+        {
+          if (!rest.empty())
+          {
+            std::map<Encoding, std::string> restEncoded;
+            _queueMessage(client, rest.size() == 1 ? rest[0] : rest, restEncoded);
+          }
+          continue;
+        }
+      }
     }
-    else
+    _queueMessage(client, message, encodedMessages);
+  }
+  return true;
+}
+
+bool JsonRpcServer::_queueMessage(Client& client, Json::Value const& message, std::map<Encoding, std::string>& encodedMessages)
+{
+  auto encoding = _encoding(client.socket.get());
+  auto encodedIt = encodedMessages.find(encoding);
+  if (encodedIt == encodedMessages.end())
+  {
+    encodedIt = encodedMessages.emplace(encoding, _encode(message, encoding)).first;
+  }
+  std::string const& data = encodedIt->second;
+  /* a burst within one loop iteration is fine as long as the socket keeps accepting it */
+  if (client.writeQueue->waitingForWrite() &&
+      client.writeQueue->queuedBytes() + data.size() > maxClientQueuedBytes)
+  {
+    FAF_LOG_ERROR << "JsonRpcServer client doesn't read its " << client.writeQueue->queuedBytes() << " queued bytes, disconnecting it";
+    _closeClient(client);
+    return false;
+  }
+  if (!client.writeQueue->send(data.c_str(), data.size()))
+  {
+    FAF_LOG_ERROR << "sending " << Json::FastWriter().write(message) << " failed";
+    _closeClient(client);
+    return false;
+  }
+  return true;
+}
+
+void JsonRpcServer::_holdNotification(Client& client, std::string const& mergeKey, Json::Value const& message)
+{
+  /* the client can't keep up, only the latest state is sent once the socket is writable */
+  auto held = std::find_if(client.heldNotifications.begin(),
+                           client.heldNotifications.end(),
+                           [&mergeKey](auto const& notification)
+                           {
+                             return notification.first == mergeKey;
+                           });
+  if (held != client.heldNotifications.end())
+  {
+    held->second = message;
+    ++_mergedNotifications;
+  }
+  else
+  {
+    client.heldNotifications.emplace_back(mergeKey, message);
+  }
+}
+
+std::string JsonRpcServer::_mergeKey(Json::Value const& message) const
+{
+  if (!message.isObject() ||
+      message.isMember("id") ||
+      !message.isMember("method"))
+  {
+    return std::string();
+  }
+  auto it = _mergeableNotifications.find(message["method"].asString());
+  if (it == _mergeableNotifications.end())
+  {
+    return std::string();
+  }
+  std::string key = it->first;
+  Json::Value const& params = message["params"];
+  for (int i = 0; i < it->second && i < static_cast<int>(params.size()); ++i)
+  {
+    key += '\n';
+    key += Json::FastWriter().write(params[i]);
+  }
+  return key;
+}
+
+void JsonRpcServer::_closeClient(Client& client)
+{
+  if (client.closing)
+  {
+    return;
+  }
+  client.closing = true;
+  ++_droppedClients;
+  client.socket->Close();
+  /* the client may be in use further up the stack, e.g. while reading its requests */
+  _closedClients.push_back(client.socket.get());
+  if (_closedClients.size() == 1)
+  {
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this);
+  }
+}
+
+void JsonRpcServer::_removeClient(rtc::AsyncSocket* socket)
+{
+  _currentMsgs.erase(socket);
+  _encodings.erase(socket);
+  _pendingNotifications.erase(std::remove_if(_pendingNotifications.begin(),
+                                             _pendingNotifications.end(),
+                                             [socket](auto const& notification)
+                                             {
+                                               return notification.first == socket;
+                                             }),
+                              _pendingNotifications.end());
+  _clients.erase(socket);
+  /* requests to all clients may still be answered by another one */
+  _failPendingRequests(_clients.empty() ? nullptr : socket, "connection closed");
+}
+
+void JsonRpcServer::OnMessage(rtc::Message* msg)
+{
+  auto closedClients = std::move(_closedClients);
+  _closedClients.clear();
+  for (auto socket : closedClients)
+  {
+    if (_clients.find(socket) != _clients.end())
     {
-      //FAF_LOG_TRACE << " done";
+      _removeClient(socket);
+      SignalClientDisconnected.emit(socket);
     }
   }
-  return true;
 }
 
 } // namespace faf
@@ -1,30 +1,76 @@
 #pragma once
 
 #include <webrtc/rtc_base/asyncsocket.h>
+#include <webrtc/rtc_base/messagehandler.h>
 
 #include "JsonRpc.h"
+#include "Signal.h"
+#include "SocketWriteQueue.h"
 
 namespace faf {
 
-class JsonRpcServer : public sigslot::has_slots<>, public JsonRpc
+class JsonRpcServer : public sigslot::has_slots<>, public rtc::MessageHandler, public JsonRpc
 {
 public:
   JsonRpcServer();
   virtual ~JsonRpcServer();
   void listen(int port, std::string const& hostname = "127.0.0.1");
 
+  /** \brief Additionally serve the clients connecting to the AF_UNIX stream socket at path
+      */
+  void listenUnix(std::string const& path);
+
   int listenPort() const;
 
-  sigslot::signal1<rtc::AsyncSocket*, sigslot::multi_threaded_local> SignalClientConnected;
-  sigslot::signal1<rtc::AsyncSocket*, sigslot::multi_threaded_local> SignalClientDisconnected;
+  /** \brief Only send the latest of these notifications to a client which can't keep up
+       \param keyParams: The number of leading parameters identifying the state, e.g. 2 for the player ids
+      */
+  void setMergeableNotification(std::string const& method, int keyParams);
+
+  /** \brief Outbound queue statistics summed up over all connected clients
+      */
+  Json::Value writeQueueStatus() const;
+
+  Signal<rtc::AsyncSocket*> SignalClientConnected;
+  Signal<rtc::AsyncSocket*> SignalClientDisconnected;
+
+  /* a client whose socket isn't writable with more queued bytes is disconnected */
+  static constexpr const std::size_t maxClientQueuedBytes = 4 * 1024 * 1024;
+
 protected:
+  struct Client
+  {
+    std::shared_ptr<rtc::AsyncSocket> socket;
+    std::unique_ptr<SocketWriteQueue> writeQueue;
+    /* mergeable notifications held back while the socket is not writable,
+     * in the order of their first occurrence */
+    std::vector<std::pair<std::string, Json::Value>> heldNotifications;
+    bool closing{false};
+  };
+
   void _onNewClient(rtc::AsyncSocket* socket);
   void _onClientDisconnect(rtc::AsyncSocket* socket, int);
+  void _onClientDrained(SocketWriteQueue* queue);
   void _onRead(rtc::AsyncSocket* socket);
-  virtual bool _sendMessage(std::string const& message, rtc::AsyncSocket* socket) override;
+  virtual bool _sendMessage(Json::Value const& message, rtc::AsyncSocket* socket) override;
+  bool _queueMessage(Client& client, Json::Value const& message, std::map<Encoding, std::string>& encodedMessages);
+  void _holdNotification(Client& client, std::string const& mergeKey, Json::Value const& message);
+  /** \brief The key of a mergeable notification, empty for other messages including batches
+      */
+  std::string _mergeKey(Json::Value const& message) const;
+  void _closeClient(Client& client);
+  void _removeClient(rtc::AsyncSocket* socket);
+  virtual void OnMessage(rtc::Message* msg) override;
 
   std::unique_ptr<rtc::AsyncSocket> _server;
-  std::map<rtc::AsyncSocket*, std::shared_ptr<rtc::AsyncSocket>> _connectedSockets;
+  std::unique_ptr<rtc::AsyncSocket> _unixServer;
+  std::string _unixSocketPath;
+  std::map<rtc::AsyncSocket*, Client> _clients;
+  std::map<std::string, int> _mergeableNotifications;
+  /* clients closed because of a failed or overflowing queue, removed on the next loop iteration */
+  std::vector<rtc::AsyncSocket*> _closedClients;
+  uint64_t _mergedNotifications{0};
+  uint64_t _droppedClients{0};
 
   RTC_DISALLOW_COPY_AND_ASSIGN(JsonRpcServer);
 };
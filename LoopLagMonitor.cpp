@@ -0,0 +1,27 @@
+#include "LoopLagMonitor.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace faf {
+
+LoopLagMonitor::LoopLagMonitor(std::string const& threadName, int intervalMs):
+  _intervalMs(intervalMs),
+  _lag(MetricsRegistry::global().histogram("faf_event_loop_lag_seconds",
+                                           "Delay of timer expiries behind their due time",
+                                           MetricsRegistry::latencyBuckets(),
+                                           MetricsRegistry::labels({{"thread", threadName}}))),
+  _lastExpiry(std::chrono::steady_clock::now())
+{
+  _timer.start(_intervalMs, std::bind(&LoopLagMonitor::_onTimer, this));
+}
+
+void LoopLagMonitor::_onTimer()
+{
+  auto now = std::chrono::steady_clock::now();
+  auto lag = now - _lastExpiry - std::chrono::milliseconds(_intervalMs);
+  _lastExpiry = now;
+  _lag->observe(std::max(0., std::chrono::duration<double>(lag).count()));
+}
+
+} // namespace faf
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "Metrics.h"
+#include "Timer.h"
+
+namespace faf {
+
+/*! \brief Measures how late the timers of the current thread fire
+ *
+ *  A repeating timer observes the delay between its due and its actual
+ *  expiry in faf_event_loop_lag_seconds, so handlers blocking the thread
+ *  show up as lag. The timer wheel ticks in milliseconds, so lag below
+ *  1 ms is not meaningful. Must be created and destroyed on the measured thread.
+ */
+class LoopLagMonitor
+{
+public:
+  LoopLagMonitor(std::string const& threadName, int intervalMs = 100);
+
+protected:
+  void _onTimer();
+
+  int _intervalMs;
+  std::shared_ptr<Histogram> _lag;
+  std::chrono::steady_clock::time_point _lastExpiry;
+  Timer _timer;
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(LoopLagMonitor);
+};
+
+} // namespace faf
@@ -0,0 +1,250 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace faf {
+
+static void appendNumber(std::string& out, double value)
+{
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.10g", value);
+  out += buffer;
+}
+
+static void appendNumber(std::string& out, uint64_t value)
+{
+  out += std::to_string(value);
+}
+
+static void appendNumber(std::string& out, int64_t value)
+{
+  out += std::to_string(value);
+}
+
+static void appendSeries(std::string& out,
+                         std::string const& name,
+                         const char* suffix,
+                         std::string const& labels,
+                         std::string const& extraLabel = std::string())
+{
+  out += name;
+  out += suffix;
+  if (!labels.empty() ||
+      !extraLabel.empty())
+  {
+    out += '{';
+    out += labels;
+    if (!labels.empty() &&
+        !extraLabel.empty())
+    {
+      out += ',';
+    }
+    out += extraLabel;
+    out += '}';
+  }
+  out += ' ';
+}
+
+Histogram::Histogram(std::vector<double> const& bounds):
+  _bounds(bounds),
+  _buckets(new std::atomic<uint64_t>[bounds.size() + 1])
+{
+  for (std::size_t i = 0; i <= _bounds.size(); ++i)
+  {
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(double value)
+{
+  auto bucket = std::size_t(std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin());
+  _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  /* std::atomic<double> has no fetch_add before C++20 */
+  double sum = _sum.load(std::memory_order_relaxed);
+  while (!_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+  {
+  }
+}
+
+MetricsRegistry& MetricsRegistry::global()
+{
+  static MetricsRegistry registry;
+  return registry;
+}
+
+template<typename T, typename FactoryT>
+std::shared_ptr<T> MetricsRegistry::_get(std::string const& name,
+                                         std::string const& help,
+                                         Type type,
+                                         std::string const& labels,
+                                         FactoryT const& factory)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto familyIt = _families.find(name);
+  if (familyIt == _families.end())
+  {
+    familyIt = _families.emplace(name, Family{type, help, {}}).first;
+  }
+  else if (familyIt->second.type != type)
+  {
+    /* a programming error, keep the metric working but unexported */
+    return factory();
+  }
+  auto& weakMetric = familyIt->second.metrics[labels];
+  auto metric = std::static_pointer_cast<T>(weakMetric.lock());
+  if (!metric)
+  {
+    metric = factory();
+    weakMetric = metric;
+  }
+  return metric;
+}
+
+std::shared_ptr<Counter> MetricsRegistry::counter(std::string const& name,
+                                                  std::string const& help,
+                                                  std::string const& labels)
+{
+  return _get<Counter>(name, help, Type::Counter, labels, []()
+  {
+    return std::make_shared<Counter>();
+  });
+}
+
+std::shared_ptr<Gauge> MetricsRegistry::gauge(std::string const& name,
+                                              std::string const& help,
+                                              std::string const& labels)
+{
+  return _get<Gauge>(name, help, Type::Gauge, labels, []()
+  {
+    return std::make_shared<Gauge>();
+  });
+}
+
+std::shared_ptr<Histogram> MetricsRegistry::histogram(std::string const& name,
+                                                      std::string const& help,
+                                                      std::vector<double> const& bounds,
+                                                      std::string const& labels)
+{
+  return _get<Histogram>(name, help, Type::Histogram, labels, [&bounds]()
+  {
+    return std::make_shared<Histogram>(bounds);
+  });
+}
+
+std::string MetricsRegistry::render()
+{
+  static const char* typeNames[] = {"counter", "gauge", "histogram"};
+  std::string out;
+  out.reserve(16 * 1024);
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto familyIt = _families.begin(); familyIt != _families.end();)
+  {
+    auto const& name = familyIt->first;
+    auto& family = familyIt->second;
+    bool headerWritten = false;
+    for (auto metricIt = family.metrics.begin(); metricIt != family.metrics.end();)
+    {
+      auto metric = metricIt->second.lock();
+      if (!metric)
+      {
+        metricIt = family.metrics.erase(metricIt);
+        continue;
+      }
+      auto const& labels = metricIt->first;
+      if (!headerWritten)
+      {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + typeNames[static_cast<int>(family.type)] + "\n";
+        headerWritten = true;
+      }
+      switch (family.type)
+      {
+        case Type::Counter:
+          appendSeries(out, name, "", labels);
+          appendNumber(out, static_cast<Counter*>(metric.get())->value());
+          out += '\n';
+          break;
+        case Type::Gauge:
+          appendSeries(out, name, "", labels);
+          appendNumber(out, static_cast<Gauge*>(metric.get())->value());
+          out += '\n';
+          break;
+        case Type::Histogram:
+        {
+          auto histogram = static_cast<Histogram*>(metric.get());
+          auto const& bounds = histogram->bounds();
+          uint64_t cumulative = 0;
+          for (std::size_t i = 0; i <= bounds.size(); ++i)
+          {
+            cumulative += histogram->bucketCount(i);
+            std::string le = "le=\"";
+            if (i < bounds.size())
+            {
+              appendNumber(le, bounds[i]);
+            }
+            else
+            {
+              le += "+Inf";
+            }
+            le += '"';
+            appendSeries(out, name, "_bucket", labels, le);
+            appendNumber(out, cumulative);
+            out += '\n';
+          }
+          appendSeries(out, name, "_sum", labels);
+          appendNumber(out, histogram->sum());
+          out += '\n';
+          appendSeries(out, name, "_count", labels);
+          appendNumber(out, cumulative);
+          out += '\n';
+          break;
+        }
+      }
+      ++metricIt;
+    }
+    if (family.metrics.empty())
+    {
+      familyIt = _families.erase(familyIt);
+    }
+    else
+    {
+      ++familyIt;
+    }
+  }
+  return out;
+}
+
+std::string MetricsRegistry::labels(std::initializer_list<std::pair<const char*, std::string>> labels)
+{
+  std::string result;
+  for (auto const& label : labels)
+  {
+    if (!result.empty())
+    {
+      result += ',';
+    }
+    result += label.first;
+    result += "=\"";
+    for (char c : label.second)
+    {
+      switch (c)
+      {
+        case '\\': result += "\\\\"; break;
+        case '"': result += "\\\""; break;
+        case '\n': result += "\\n"; break;
+        default: result += c; break;
+      }
+    }
+    result += '"';
+  }
+  return result;
+}
+
+std::vector<double> const& MetricsRegistry::latencyBuckets()
+{
+  static const std::vector<double> buckets{0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1., 2.5};
+  return buckets;
+}
+
+} // namespace faf
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace faf {
+
+class Metric
+{
+public:
+  virtual ~Metric() = default;
+};
+
+/*! \brief Monotonic counter
+ */
+class Counter : public Metric
+{
+public:
+  void inc(uint64_t n = 1)
+  {
+    _value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t value() const
+  {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::atomic<uint64_t> _value{0};
+};
+
+/*! \brief Value which can go up and down
+ */
+class Gauge : public Metric
+{
+public:
+  void set(int64_t value)
+  {
+    _value.store(value, std::memory_order_relaxed);
+  }
+
+  void add(int64_t n)
+  {
+    _value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  int64_t value() const
+  {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::atomic<int64_t> _value{0};
+};
+
+/*! \brief Histogram with fixed upper bucket bounds
+ *
+ *  A sample is counted in the first bucket whose bound is at least the
+ *  sample, or in the +Inf bucket. The buckets are not cumulative, the
+ *  registry sums them up when rendering.
+ */
+class Histogram : public Metric
+{
+public:
+  explicit Histogram(std::vector<double> const& bounds);
+
+  void observe(double value);
+
+  std::vector<double> const& bounds() const
+  {
+    return _bounds;
+  }
+
+  /** \brief The number of samples in bucket i, bounds().size() is the +Inf bucket
+      */
+  uint64_t bucketCount(std::size_t i) const
+  {
+    return _buckets[i].load(std::memory_order_relaxed);
+  }
+
+  double sum() const
+  {
+    return _sum.load(std::memory_order_relaxed);
+  }
+
+protected:
+  std::vector<double> _bounds;
+  std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+  std::atomic<double> _sum{0.};
+};
+
+/*! \brief Process wide registry of the metrics, rendered in the Prometheus text format
+ *
+ *  The owners of the metrics keep them alive via the returned shared_ptrs
+ *  and update them without locking from any thread. The registry only keeps
+ *  weak references, so the metrics of e.g. a destroyed PeerRelay vanish
+ *  from the output. Requesting a metric with the same name and labels again
+ *  returns the existing one while it is alive.
+ */
+class MetricsRegistry
+{
+public:
+  static MetricsRegistry& global();
+
+  /** \param labels: Rendered labels from labels(), empty for none
+      */
+  std::shared_ptr<Counter> counter(std::string const& name,
+                                   std::string const& help,
+                                   std::string const& labels = std::string());
+  std::shared_ptr<Gauge> gauge(std::string const& name,
+                               std::string const& help,
+                               std::string const& labels = std::string());
+  /** \param bounds: The ascending upper bucket bounds, all metrics of one name must use the same
+      */
+  std::shared_ptr<Histogram> histogram(std::string const& name,
+                                       std::string const& help,
+                                       std::vector<double> const& bounds,
+                                       std::string const& labels = std::string());
+
+  /** \brief Render all live metrics in the Prometheus text exposition format 0.0.4
+      */
+  std::string render();
+
+  /** \brief Render label pairs as name="value",... with escaped values
+      */
+  static std::string labels(std::initializer_list<std::pair<const char*, std::string>> labels);
+
+  /** \brief Bucket bounds in seconds from 100 µs to 2.5 s
+      */
+  static std::vector<double> const& latencyBuckets();
+
+protected:
+  enum class Type
+  {
+    Counter,
+    Gauge,
+    Histogram
+  };
+
+  struct Family
+  {
+    Type type;
+    std::string help;
+    std::map<std::string, std::weak_ptr<Metric>> metrics;
+  };
+
+  template<typename T, typename FactoryT>
+  std::shared_ptr<T> _get(std::string const& name,
+                          std::string const& help,
+                          Type type,
+                          std::string const& labels,
+                          FactoryT const& factory);
+
+  std::mutex _mutex;
+  std::map<std::string, Family> _families;
+};
+
+} // namespace faf
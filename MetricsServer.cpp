@@ -0,0 +1,173 @@
+#include "MetricsServer.h"
+
+#include <algorithm>
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "logging.h"
+#include "Metrics.h"
+
+namespace faf {
+
+MetricsServer::MetricsServer():
+  _server(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(SOCK_STREAM))
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+}
+
+bool MetricsServer::listen(int port, std::string const& hostname)
+{
+  _server->SignalReadEvent.connect(this, &MetricsServer::_onNewClient);
+  if (_server->Bind(rtc::SocketAddress(hostname, port)) != 0)
+  {
+    FAF_LOG_ERROR << "MetricsServer: unable to bind to port " << port;
+    return false;
+  }
+  _server->Listen(5);
+  FAF_LOG_INFO << "MetricsServer listening on http://" << hostname << ":" << _server->GetLocalAddress().port() << "/metrics";
+  return true;
+}
+
+int MetricsServer::listenPort() const
+{
+  return _server->GetLocalAddress().port();
+}
+
+void MetricsServer::_onNewClient(rtc::AsyncSocket* socket)
+{
+  rtc::SocketAddress acceptAddress;
+  auto newSocket = socket->Accept(&acceptAddress);
+  if (!newSocket)
+  {
+    return;
+  }
+  newSocket->SignalReadEvent.connect(this, &MetricsServer::_onRead);
+  newSocket->SignalCloseEvent.connect(this, &MetricsServer::_onClientClose);
+  Client& client = _clients[newSocket];
+  client.socket.reset(newSocket);
+  client.writeQueue = std::make_unique<SocketWriteQueue>(newSocket);
+  client.writeQueue->SignalDrained.connect(this, &MetricsServer::_onClientDrained);
+}
+
+void MetricsServer::_onClientClose(rtc::AsyncSocket* socket, int error)
+{
+  _close(socket);
+}
+
+void MetricsServer::_onClientDrained(SocketWriteQueue* queue)
+{
+  _close(queue->socket());
+}
+
+void MetricsServer::_onRead(rtc::AsyncSocket* socket)
+{
+  auto it = _clients.find(socket);
+  if (it == _clients.end())
+  {
+    return;
+  }
+  Client& client = it->second;
+  char buffer[2048];
+  int received;
+  while ((received = socket->Recv(buffer, sizeof(buffer), nullptr)) > 0)
+  {
+    if (!client.responded)
+    {
+      client.request.append(buffer, std::size_t(received));
+    }
+  }
+  if (client.responded)
+  {
+    return;
+  }
+  auto headerEnd = client.request.find("\r\n\r\n");
+  if (headerEnd == std::string::npos)
+  {
+    headerEnd = client.request.find("\n\n");
+  }
+  if (headerEnd == std::string::npos)
+  {
+    if (client.request.size() > maxRequestSize)
+    {
+      _respond(client, "431 Request Header Fields Too Large", "text/plain", "request too large\n");
+    }
+    return;
+  }
+
+  /* request line: METHOD SP PATH SP VERSION */
+  auto requestLine = client.request.substr(0, client.request.find_first_of("\r\n"));
+  auto methodEnd = requestLine.find(' ');
+  auto pathEnd = requestLine.find(' ', methodEnd == std::string::npos ? methodEnd : methodEnd + 1);
+  if (methodEnd == std::string::npos)
+  {
+    _respond(client, "400 Bad Request", "text/plain", "bad request\n");
+    return;
+  }
+  auto method = requestLine.substr(0, methodEnd);
+  auto path = requestLine.substr(methodEnd + 1, pathEnd == std::string::npos ? std::string::npos : pathEnd - methodEnd - 1);
+  path = path.substr(0, path.find('?'));
+  if (method != "GET")
+  {
+    _respond(client, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+  }
+  else if (path != "/metrics")
+  {
+    _respond(client, "404 Not Found", "text/plain", "the metrics are served at /metrics\n");
+  }
+  else
+  {
+    ++_scrapes;
+    _respond(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8", MetricsRegistry::global().render());
+  }
+}
+
+void MetricsServer::_respond(Client& client, const char* status, std::string const& contentType, std::string const& body)
+{
+  client.responded = true;
+  client.request.clear();
+  std::string response = std::string("HTTP/1.0 ") + status + "\r\n"
+                         "Content-Type: " + contentType + "\r\n"
+                         "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                         "Connection: close\r\n"
+                         "\r\n";
+  response += body;
+  client.writeQueue->send(response.data(), response.size());
+  client.writeQueue->flush();
+  /* otherwise the client is closed once the queue was drained */
+  if (!client.writeQueue->waitingForWrite())
+  {
+    _close(client.socket.get());
+  }
+}
+
+void MetricsServer::_close(rtc::AsyncSocket* socket)
+{
+  auto it = _clients.find(socket);
+  if (it == _clients.end() ||
+      std::find(_closedClients.begin(), _closedClients.end(), socket) != _closedClients.end())
+  {
+    return;
+  }
+  socket->Close();
+  /* the socket may be in use further up the stack */
+  _closedClients.push_back(socket);
+  if (_closedClients.size() == 1)
+  {
+    rtc::Thread::Current()->Post(RTC_FROM_HERE, this);
+  }
+}
+
+void MetricsServer::OnMessage(rtc::Message* msg)
+{
+  auto closedClients = std::move(_closedClients);
+  _closedClients.clear();
+  for (auto socket : closedClients)
+  {
+    _clients.erase(socket);
+  }
+}
+
+} // namespace faf
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <webrtc/rtc_base/asyncsocket.h>
+#include <webrtc/rtc_base/messagehandler.h>
+
+#include "SocketWriteQueue.h"
+
+namespace faf {
+
+/*! \brief Minimal HTTP/1.0 server answering GET /metrics with the MetricsRegistry
+ *
+ *  Every connection serves one request and is closed after the response was
+ *  written, which is what Prometheus and curl expect from a plain endpoint.
+ *  Must be used on the thread it was created on.
+ */
+class MetricsServer : public sigslot::has_slots<>, public rtc::MessageHandler
+{
+public:
+  MetricsServer();
+  virtual ~MetricsServer();
+
+  /** \returns false if the port can't be bound
+      */
+  bool listen(int port, std::string const& hostname = "127.0.0.1");
+
+  int listenPort() const;
+
+  uint64_t scrapes() const
+  {
+    return _scrapes;
+  }
+
+  /* requests with longer headers are answered with an error */
+  static constexpr const std::size_t maxRequestSize = 8 * 1024;
+
+protected:
+  struct Client
+  {
+    std::unique_ptr<rtc::AsyncSocket> socket;
+    std::unique_ptr<SocketWriteQueue> writeQueue;
+    std::string request;
+    bool responded{false};
+  };
+
+  void _onNewClient(rtc::AsyncSocket* socket);
+  void _onClientClose(rtc::AsyncSocket* socket, int error);
+  void _onClientDrained(SocketWriteQueue* queue);
+  void _onRead(rtc::AsyncSocket* socket);
+  void _respond(Client& client, const char* status, std::string const& contentType, std::string const& body);
+  void _close(rtc::AsyncSocket* socket);
+  virtual void OnMessage(rtc::Message* msg) override;
+
+  std::unique_ptr<rtc::AsyncSocket> _server;
+  std::map<rtc::AsyncSocket*, Client> _clients;
+  /* closed clients, removed on the next loop iteration */
+  std::vector<rtc::AsyncSocket*> _closedClients;
+  uint64_t _scrapes{0};
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(MetricsServer);
+};
+
+} // namespace faf
@@ -0,0 +1,53 @@
+#include "PacketBufferPool.h"
+
+#include <webrtc/rtc_base/checks.h>
+
+namespace faf {
+
+PacketBufferPool::PacketBufferPool(std::size_t bufferSize, std::size_t poolSize):
+  _bufferSize(bufferSize),
+  _slots(poolSize)
+{
+  for (auto& slot : _slots)
+  {
+    slot.buffer.EnsureCapacity(_bufferSize);
+  }
+}
+
+std::size_t PacketBufferPool::acquire(uint64_t releasedBytes)
+{
+  RTC_CHECK_LT(_reservedCount, _slots.size()) << "every buffer of the PacketBufferPool is reserved";
+  ++_acquisitions;
+  std::size_t index = _slots.size();
+  std::size_t fallback = _slots.size();
+  for (std::size_t i = 0; i < _slots.size(); ++i)
+  {
+    std::size_t candidate = (_next + i) % _slots.size();
+    if (_slots[candidate].releaseOffset == reserved)
+    {
+      continue;
+    }
+    if (_slots[candidate].releaseOffset <= releasedBytes)
+    {
+      index = candidate;
+      break;
+    }
+    if (fallback == _slots.size())
+    {
+      fallback = candidate;
+    }
+  }
+  if (index == _slots.size())
+  {
+    /* every buffer is still queued, the next write will reallocate */
+    ++_misses;
+    index = fallback;
+  }
+  _next = (index + 1) % _slots.size();
+  _slots[index].releaseOffset = reserved;
+  ++_reservedCount;
+  _slots[index].buffer.SetSize(_bufferSize);
+  return index;
+}
+
+} // namespace faf
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <webrtc/rtc_base/copyonwritebuffer.h>
+
+namespace faf {
+
+/*! \brief A ring of preallocated packet buffers for the game -> datachannel path
+ *
+ *  webrtc::DataChannelInterface::Send() keeps a reference to the sent buffer
+ *  while the message is queued in the data channel. Writing into such a
+ *  buffer again would trigger a copy-on-write reallocation, so the pool tracks
+ *  the byte offset each buffer was sent at and only hands out buffers the
+ *  data channel has already released.
+ */
+class PacketBufferPool
+{
+public:
+  PacketBufferPool(std::size_t bufferSize, std::size_t poolSize);
+
+  /** \brief Get the index of the next buffer which is not referenced by a pending send
+   *         The buffer is resized to the full buffer size and stays reserved
+   *         until markSent() or release() is called.
+   *         Fewer than size() buffers may be reserved at the same time,
+   *         the others are needed to fall back to while all are referenced.
+       \param releasedBytes: The number of sent bytes the data channel has released so far
+       \returns The index of the buffer for use with buffer() and markSent()
+      */
+  std::size_t acquire(uint64_t releasedBytes);
+
+  rtc::CopyOnWriteBuffer& buffer(std::size_t index)
+  {
+    return _slots[index].buffer;
+  }
+
+  /** \brief Mark a buffer as referenced until the consumer released sentBytes bytes
+      */
+  void markSent(std::size_t index, uint64_t sentBytes)
+  {
+    _unreserve(index);
+    _slots[index].releaseOffset = sentBytes;
+  }
+
+  /** \brief Return a reserved buffer which was not sent
+      */
+  void release(std::size_t index)
+  {
+    _unreserve(index);
+    _slots[index].releaseOffset = 0;
+  }
+
+  std::size_t size() const
+  {
+    return _slots.size();
+  }
+
+  uint64_t acquisitions() const
+  {
+    return _acquisitions;
+  }
+
+  /** \brief The number of acquisitions which had to reuse a still referenced buffer,
+   *         causing a reallocation on the next write
+      */
+  uint64_t misses() const
+  {
+    return _misses;
+  }
+
+  std::size_t reservedCount() const
+  {
+    return _reservedCount;
+  }
+
+protected:
+  static constexpr const uint64_t reserved = UINT64_MAX;
+
+  struct Slot
+  {
+    rtc::CopyOnWriteBuffer buffer;
+    uint64_t releaseOffset{0};
+  };
+
+  void _unreserve(std::size_t index)
+  {
+    if (_slots[index].releaseOffset == reserved)
+    {
+      --_reservedCount;
+    }
+  }
+
+  std::size_t _bufferSize;
+  std::vector<Slot> _slots;
+  std::size_t _next{0};
+  std::size_t _reservedCount{0};
+  uint64_t _acquisitions{0};
+  uint64_t _misses{0};
+};
+
+} // namespace faf
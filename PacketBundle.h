@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace faf {
+
+/*! \brief Framing of several game packets in one data channel message
+ *
+ *  A bundle is the magic followed by records of
+ *  [uint16 little endian packet length][packet].
+ *  Bundles are only exchanged after both peers announced the "bundle"
+ *  feature. Then a game packet starting with the magic is always sent as a
+ *  bundle, so the receiver can treat every message with the magic as one.
+ */
+class PacketBundle
+{
+public:
+  static constexpr uint8_t magic[] = {'F', 'A', 'F', 'B'};
+  static constexpr std::size_t recordHeaderSize = 2;
+  static constexpr std::size_t maxPacketSize = 0xffff;
+
+  static bool hasMagic(const uint8_t* data, std::size_t size)
+  {
+    return size >= sizeof(magic) &&
+           std::equal(magic, magic + sizeof(magic), data);
+  }
+
+  /** \brief Start a bundle in an empty buffer with AppendData() like rtc::CopyOnWriteBuffer
+      */
+  template<typename Buffer>
+  static void begin(Buffer& bundle)
+  {
+    bundle.AppendData(magic, sizeof(magic));
+  }
+
+  /** \brief Append a packet of at most maxPacketSize bytes
+      */
+  template<typename Buffer>
+  static void append(Buffer& bundle, const uint8_t* packet, std::size_t size)
+  {
+    uint8_t recordHeader[recordHeaderSize] = {
+      static_cast<uint8_t>(size & 0xff),
+      static_cast<uint8_t>(size >> 8)
+    };
+    bundle.AppendData(recordHeader, sizeof(recordHeader));
+    bundle.AppendData(packet, size);
+  }
+
+  /** \brief Call callback(packet, size) for every packet of a valid bundle
+       \returns false without calling callback if data is not a valid bundle
+      */
+  template<typename Callback>
+  static bool forEach(const uint8_t* data, std::size_t size, Callback&& callback)
+  {
+    if (!hasMagic(data, size))
+    {
+      return false;
+    }
+    /* validate the whole framing before forwarding anything */
+    std::size_t pos = sizeof(magic);
+    while (pos + recordHeaderSize <= size)
+    {
+      pos += recordHeaderSize + _recordSize(data + pos);
+    }
+    if (pos != size)
+    {
+      return false;
+    }
+    pos = sizeof(magic);
+    while (pos < size)
+    {
+      std::size_t packetSize = _recordSize(data + pos);
+      callback(data + pos + recordHeaderSize, packetSize);
+      pos += recordHeaderSize + packetSize;
+    }
+    return true;
+  }
+
+protected:
+  static std::size_t _recordSize(const uint8_t* recordHeader)
+  {
+    return std::size_t(recordHeader[0]) | (std::size_t(recordHeader[1]) << 8);
+  }
+};
+
+} // namespace faf
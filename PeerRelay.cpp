@@ -1,20 +1,44 @@
 #include "PeerRelay.h"
 
 #include <algorithm>
+#include <cmath>
 
+#if defined(WEBRTC_LINUX)
+#  include <sys/socket.h>
+#  include <webrtc/rtc_base/physicalsocketserver.h>
+#endif
+
+#include "DatagramSocket.h"
+#include "EventTrace.h"
+#include "GameSocketPool.h"
 #include "logging.h"
+#include "Metrics.h"
+#include "PacketBundle.h"
 #include "PeerRelayObservers.h"
 
 namespace faf {
 
-#define RELAY_LOG_ERROR FAF_LOG_ERROR << "PeerRelay for " << _remotePlayerLogin << " (" << _remotePlayerId << "): "
-#define RELAY_LOG_WARN FAF_LOG_WARN << "PeerRelay for " << _remotePlayerLogin << " (" << _remotePlayerId << "): "
-#define RELAY_LOG_INFO FAF_LOG_INFO << "PeerRelay for " << _remotePlayerLogin << " (" << _remotePlayerId << "): "
-#define RELAY_LOG_DEBUG FAF_LOG_DEBUG << "PeerRelay for " << _remotePlayerLogin << " (" << _remotePlayerId << "): "
-#define RELAY_LOG_TRACE FAF_LOG_TRACE << "PeerRelay for " << _remotePlayerLogin << " (" << _remotePlayerId << "): "
+#define RELAY_LOG_ERROR FAF_LOG_ERROR << _logPrefix
+#define RELAY_LOG_WARN FAF_LOG_WARN << _logPrefix
+#define RELAY_LOG_INFO FAF_LOG_INFO << _logPrefix
+#define RELAY_LOG_DEBUG FAF_LOG_DEBUG << _logPrefix
+#define RELAY_LOG_TRACE FAF_LOG_TRACE << _logPrefix
 
 static constexpr uint8_t PingMessage[] = "ICEADAPTERPING";
 static constexpr uint8_t PongMessage[] = "ICEADAPTERPONG";
+/* Sequenced pings and pongs append [uint32 sequence number][uint64 send timestamp in us],
+ * both little endian. The answerer echoes the payload unmodified. */
+static constexpr std::size_t PingPayloadSize = 4 + 8;
+
+/* Estimated per-message overhead of the SCTP common and DATA chunk header,
+ * the DTLS record with AES-GCM and UDP/IPv4 */
+static constexpr std::size_t EstimatedMessageOverhead = 12 + 16 + 37 + 28;
+
+static constexpr char const* BundleFeature = "bundle";
+static constexpr char const* PingSeqFeature = "ping_seq";
+static constexpr char const* NegotiatedDataChannelFeature = "negotiated_datachannel";
+/* Stream id of the out-of-band negotiated data channel */
+static constexpr int NegotiatedDataChannelId = 0;
 
 PeerRelay::PeerRelay(Options options,
                      Callbacks callbacks,
@@ -30,18 +54,62 @@ PeerRelay::PeerRelay(Options options,
   _peerConnectionObserver(std::make_shared<PeerConnectionObserver>(this)),
   _remotePlayerId(options.remotePlayerId),
   _remotePlayerLogin(options.remotePlayerLogin),
+  _logPrefix("PeerRelay for " + options.remotePlayerLogin + " (" + std::to_string(options.remotePlayerId) + "): "),
   _isOfferer(options.isOfferer),
   _gameUdpAddress("127.0.0.1", options.gameUdpPort),
-  _localUdpSocket(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(AF_INET, SOCK_DGRAM)),
-  _callbacks(callbacks)
+  _bundlePackets(options.bundlePackets),
+  _bundleWindowUs(options.bundleWindowUs),
+  _reconnectQueue(std::size_t(std::max(0, options.reconnectBufferPackets))),
+  _reconnectQueueMaxAge(options.reconnectBufferMs),
+  _negotiatedDataChannel(options.negotiatedDataChannel),
+  _callbacks(callbacks),
+  _rttProbeIntervalMs(unsigned(std::max(0, options.rttProbeIntervalMs)))
 {
-  _localUdpSocket->SignalReadEvent.connect(this, &PeerRelay::_onPeerdataFromGame);
-  if (_localUdpSocket->Bind(rtc::SocketAddress("127.0.0.1", 0)) != 0)
+  _initMetrics();
+  if (options.gameSocketPool)
   {
-    RELAY_LOG_ERROR << "unable to bind local udp socket";
+    auto address = options.gameSocketPool->add(this);
+    if (address)
+    {
+      _gameSocketPool = options.gameSocketPool;
+      _localGameAddress = *address;
+    }
+    else
+    {
+      RELAY_LOG_WARN << "no address left in the game socket pool, using an own socket";
+    }
+  }
+  if (!_gameSocketPool)
+  {
+#if defined(WEBRTC_POSIX)
+    auto localUdpSocket = DatagramSocket::create(AF_INET);
+    if (localUdpSocket)
+    {
+      localUdpSocket->SignalReadable.connect(this, &PeerRelay::_onPeerdataFromGame);
+    }
+    _localUdpSocket.reset(localUdpSocket);
+#else
+    _localUdpSocket.reset(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(AF_INET, SOCK_DGRAM));
+    if (_localUdpSocket)
+    {
+      _localUdpSocket->SignalReadEvent.connect(this, &PeerRelay::_onPeerdataFromGame);
+    }
+#endif
+    if (!_localUdpSocket)
+    {
+      RELAY_LOG_ERROR << "unable to create local udp socket";
+    }
+    else
+    {
+      if (_localUdpSocket->Bind(rtc::SocketAddress("127.0.0.1", 0)) != 0)
+      {
+        RELAY_LOG_ERROR << "unable to bind local udp socket";
+      }
+      _localGameAddress = rtc::SocketAddress("127.0.0.1", _localUdpSocket->GetLocalAddress().port());
+    }
   }
-  _localUdpSocketPort = _localUdpSocket->GetLocalAddress().port();
-  RELAY_LOG_INFO << "listening on UDP port " << _localUdpSocketPort;
+  _localUdpSocketPort = _localGameAddress.port();
+  RELAY_LOG_INFO << "listening on UDP address " << _localGameAddress.ToString();
 
   _connectStartTime = std::chrono::steady_clock::now();
 
@@ -56,6 +124,8 @@ PeerRelay::PeerRelay(Options options,
     FAF_LOG_ERROR << "_pcfactory->CreatePeerConnection() failed!";
   }
 
+  EventTrace::record(TraceEvent::RelayCreated, _remotePlayerId, _isOfferer ? 1 : 0);
+
   if (_isOfferer)
   {
     _createOffer();
@@ -64,6 +134,7 @@ PeerRelay::PeerRelay(Options options,
 
 PeerRelay::~PeerRelay()
 {
+  EventTrace::record(TraceEvent::RelayDestroyed, _remotePlayerId);
   _closing = true;
   if (_dataChannel)
   {
@@ -75,6 +146,10 @@ PeerRelay::~PeerRelay()
     _peerConnection->Close();
     _peerConnection.release();
   }
+  if (_gameSocketPool)
+  {
+    _gameSocketPool->remove(this);
+  }
 }
 
 int PeerRelay::localUdpSocketPort() const
@@ -82,12 +157,32 @@ int PeerRelay::localUdpSocketPort() const
   return _localUdpSocketPort;
 }
 
+rtc::SocketAddress const& PeerRelay::localGameAddress() const
+{
+  return _localGameAddress;
+}
+
+void PeerRelay::onGameDatagram(const uint8_t* data, std::size_t size)
+{
+  ++_gameReadDatagrams;
+  auto bufferIndex = _sendBufferPool.acquire(_dataChannelReleasedBytes());
+  auto& buffer = _sendBufferPool.buffer(bufferIndex);
+  std::copy(data, data + std::min(size, buffer.size()), buffer.data());
+  _forwardGameDatagram(bufferIndex, std::min(size, buffer.size()));
+}
+
+void PeerRelay::onGameDatagramsDone()
+{
+  _scheduleBundleFlush();
+}
+
 Json::Value PeerRelay::status() const
 {
   Json::Value result;
   result["remote_player_id"] = _remotePlayerId;
   result["remote_player_login"] = _remotePlayerLogin;
   result["local_game_udp_port"] = _localUdpSocketPort;
+  result["local_game_address"] = _localGameAddress.ToString();
   result["ice"] = Json::Value();
   result["ice"]["offerer"] = _isOfferer;
   result["ice"]["state"] = _iceState;
@@ -98,7 +193,52 @@ Json::Value PeerRelay::status() const
   result["ice"]["rem_cand_addr"] = _remoteCandAddress;
   result["ice"]["loc_cand_type"] = _localCandType;
   result["ice"]["rem_cand_type"] = _remoteCandType;
+  result["ice"]["time_to_datachannel_open"] = _dataChannelOpenDuration ? std::chrono::duration_cast<std::chrono::milliseconds>(*_dataChannelOpenDuration).count() / 1000. : 0.;
+  result["ice"]["datachannel_negotiated"] = _dataChannelNegotiated;
+  result["ice"]["candidates_added"] = Json::UInt64(_candidatesAdded);
+  result["ice"]["candidates_queued"] = Json::UInt64(_candidatesQueued);
+  result["ice"]["candidates_pending"] = Json::UInt64(_pendingCandidates.size());
+  result["ice"]["candidates_dropped"] = Json::UInt64(_candidatesDropped);
+  result["ice"]["candidates_failed"] = Json::UInt64(_candidatesFailed);
   result["ice"]["time_to_connected"] = _isConnected ? std::chrono::duration_cast<std::chrono::milliseconds>(_connectDuration).count() / 1000. : 0.;
+  result["ice"]["smoothed_rtt_ms"] = _smoothedRttMs ? *_smoothedRttMs : 0.;
+  result["ice"]["rtt_variation_ms"] = _rttVariationMs;
+  result["ice"]["silence_limit_ms"] = Json::Int64(_silenceLimit().count());
+  result["ice"]["probes_sent"] = Json::UInt64(_probesSent);
+  result["ice"]["rtt_samples"] = Json::UInt64(_pingStats.samples());
+  result["ice"]["rtt_min_ms"] = _pingStats.minMs();
+  result["ice"]["rtt_median_ms"] = _pingStats.percentileMs(0.5);
+  result["ice"]["rtt_p95_ms"] = _pingStats.percentileMs(0.95);
+  result["ice"]["rtt_p99_ms"] = _pingStats.percentileMs(0.99);
+  result["ice"]["rtt_max_ms"] = _pingStats.maxMs();
+  result["ice"]["rtt_jitter_ms"] = _pingStats.jitterMs();
+  result["ice"]["pings_lost"] = Json::UInt64(_pingStats.lost());
+  result["ice"]["ping_loss_rate"] = _pingStats.lossRate();
+  result["ice"]["liveness_restarts"] = Json::UInt64(_livenessRestarts);
+  result["game_socket"] = Json::Value();
+  result["game_socket"]["read_wakeups"] = Json::UInt64(_gameReadWakeups);
+  result["game_socket"]["read_syscalls"] = Json::UInt64(_gameReadSyscalls);
+  result["game_socket"]["read_datagrams"] = Json::UInt64(_gameReadDatagrams);
+  result["game_socket"]["datagrams_per_wakeup"] = _gameReadWakeups > 0 ? double(_gameReadDatagrams) / _gameReadWakeups : 0.;
+  result["game_socket"]["max_datagrams_per_wakeup"] = Json::UInt64(_gameReadMaxBatch);
+  result["game_socket"]["send_buffer_pool_size"] = Json::UInt64(_sendBufferPool.size());
+  result["game_socket"]["send_buffer_pool_misses"] = Json::UInt64(_sendBufferPool.misses());
+  result["bundling"] = Json::Value();
+  result["bundling"]["active"] = _bundlingNegotiated();
+  result["bundling"]["bundles_sent"] = Json::UInt64(_bundlesSent);
+  result["bundling"]["bundled_packets"] = Json::UInt64(_bundledPackets);
+  result["bundling"]["packets_per_bundle"] = _bundlesSent > 0 ? double(_bundledPackets) / _bundlesSent : 0.;
+  result["bundling"]["bundles_received"] = Json::UInt64(_bundlesReceived);
+  int64_t bytesSaved = int64_t(_bundledPackets - _bundlesSent) * int64_t(EstimatedMessageOverhead) - int64_t(_bundleFramingBytes);
+  result["bundling"]["bytes_saved"] = Json::Int64(bytesSaved);
+  result["reconnect_buffer"] = Json::Value();
+  result["reconnect_buffer"]["capacity"] = Json::UInt64(_reconnectQueue.size());
+  result["reconnect_buffer"]["max_age_ms"] = Json::Int64(_reconnectQueueMaxAge.count());
+  result["reconnect_buffer"]["queued"] = Json::UInt64(_reconnectQueueSize);
+  result["reconnect_buffer"]["total_queued"] = Json::UInt64(_reconnectQueuedPackets);
+  result["reconnect_buffer"]["flushed"] = Json::UInt64(_reconnectFlushedPackets);
+  result["reconnect_buffer"]["dropped_overflow"] = Json::UInt64(_reconnectDroppedOverflow);
+  result["reconnect_buffer"]["dropped_expired"] = Json::UInt64(_reconnectDroppedExpired);
   return result;
 }
 
@@ -114,7 +254,9 @@ void PeerRelay::setIceServers(webrtc::PeerConnectionInterface::IceServers const&
 
 void PeerRelay::addIceMessage(Json::Value const& iceMsg)
 {
-  FAF_LOG_DEBUG << "addIceMessage: " << Json::FastWriter().write(iceMsg);
+  /* serialize the whole message only at the most verbose level */
+  RELAY_LOG_DEBUG << "addIceMessage: " << iceMsg["type"].asString();
+  RELAY_LOG_TRACE << "addIceMessage: " << Json::FastWriter().write(iceMsg);
   if (!_peerConnection)
   {
     FAF_LOG_ERROR << "!_peerConnection";
@@ -123,10 +265,22 @@ void PeerRelay::addIceMessage(Json::Value const& iceMsg)
   if (iceMsg["type"].asString() == "offer" ||
       iceMsg["type"].asString() == "answer")
   {
+    EventTrace::record(TraceEvent::RemoteDescription,
+                       _remotePlayerId,
+                       static_cast<uint64_t>(iceMsg["type"].asString() == "offer" ? TraceSdpType::Offer : TraceSdpType::Answer));
+    _setRemoteFeatures(iceMsg["features"]);
+    if (!_isOfferer &&
+        !_dataChannel &&
+        _remoteFeatures.count(NegotiatedDataChannelFeature) > 0)
+    {
+      /* the offerer won't announce the channel in-band, create our end before applying the offer */
+      _createDataChannel(true);
+    }
     webrtc::SdpParseError error;
     auto sdp = webrtc::CreateSessionDescription(iceMsg["type"].asString(), iceMsg["sdp"].asString(), &error);
     if (sdp)
     {
+      _remoteDescriptionPending = true;
       _peerConnection->SetRemoteDescription(_setRemoteDescriptionObserver, sdp);
     }
     else
@@ -137,20 +291,75 @@ void PeerRelay::addIceMessage(Json::Value const& iceMsg)
   else if (iceMsg["type"].asString() == "candidate")
   {
     webrtc::SdpParseError error;
-    auto candidate = webrtc::CreateIceCandidate(iceMsg["candidate"]["sdpMid"].asString(),
-                                                iceMsg["candidate"]["sdpMLineIndex"].asInt(),
-                                                iceMsg["candidate"]["candidate"].asString(),
-                                                &error);
+    std::unique_ptr<webrtc::IceCandidateInterface> candidate(webrtc::CreateIceCandidate(iceMsg["candidate"]["sdpMid"].asString(),
+                                                                                         iceMsg["candidate"]["sdpMLineIndex"].asInt(),
+                                                                                         iceMsg["candidate"]["candidate"].asString(),
+                                                                                         &error));
     if (!candidate)
     {
       FAF_LOG_ERROR << "parsing ICE candidate failed: " << error.description;
+      ++_candidatesFailed;
+    }
+    else if (_remoteDescriptionPending ||
+             !_peerConnection->remote_description())
+    {
+      /* the candidate overtook its offer/answer, keep it until the description is applied */
+      EventTrace::record(TraceEvent::RemoteCandidate,
+                         _remotePlayerId,
+                         static_cast<uint64_t>(EventTrace::candidateType(candidate->candidate().type())),
+                         1);
+      if (_pendingCandidates.size() >= maxPendingCandidates)
+      {
+        RELAY_LOG_WARN << "pending ICE candidate queue full, dropping the oldest candidate";
+        _pendingCandidates.erase(_pendingCandidates.begin());
+        ++_candidatesDropped;
+      }
+      _pendingCandidates.push_back(std::move(candidate));
+      ++_candidatesQueued;
+    }
+    else
+    {
+      EventTrace::record(TraceEvent::RemoteCandidate,
+                         _remotePlayerId,
+                         static_cast<uint64_t>(EventTrace::candidateType(candidate->candidate().type())));
+      _addIceCandidate(candidate.get());
+    }
+  }
+}
+
+void PeerRelay::_addIceCandidate(webrtc::IceCandidateInterface const* candidate)
+{
+  if (_peerConnection->AddIceCandidate(candidate))
+  {
+    ++_candidatesAdded;
+  }
+  else
+  {
+    FAF_LOG_ERROR << "adding ICE candidate failed";
+    ++_candidatesFailed;
+  }
+}
+
+void PeerRelay::_onRemoteDescriptionSet(bool success)
+{
+  _remoteDescriptionPending = false;
+  EventTrace::record(TraceEvent::RemoteDescriptionSet, _remotePlayerId, success ? 1 : 0);
+  if (!_pendingCandidates.empty())
+  {
+    RELAY_LOG_DEBUG << (success ? "adding " : "dropping ") << _pendingCandidates.size() << " pending ICE candidates";
+  }
+  for (auto const& candidate : _pendingCandidates)
+  {
+    if (success && _peerConnection)
+    {
+      _addIceCandidate(candidate.get());
     }
-    else if (!_peerConnection->AddIceCandidate(candidate))
+    else
     {
-      FAF_LOG_ERROR << "adding ICE candidate failed";
-    };
-    delete candidate;
+      ++_candidatesDropped;
+    }
   }
+  _pendingCandidates.clear();
 }
 
 void PeerRelay::_createOffer()
@@ -161,22 +370,56 @@ void PeerRelay::_createOffer()
     if (!_dataChannel)
     {
       reconnect = false;
-      webrtc::DataChannelInit dataChannelInit;
-      dataChannelInit.ordered = false;
-      dataChannelInit.maxRetransmits = 0;
-      _dataChannel = _peerConnection->CreateDataChannel("faf",
-                                                        &dataChannelInit);
-      _dataChannel->RegisterObserver(_dataChannelObserver.get());
+      _createDataChannel(_negotiatedDataChannel);
     }
     webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
     options.offer_to_receive_audio = 0;
     options.offer_to_receive_video = 0;
     options.ice_restart = reconnect;
+    if (reconnect)
+    {
+      _metrics.iceRestarts->inc();
+    }
     _peerConnection->CreateOffer(_createOfferObserver,
                                  options);
-    /* restart the timer to ensure we have the full check interval to be connected */
-    _offererConnectionCheckTimer.start(_connectionCheckIntervalMs, std::bind(&PeerRelay::_checkConnection, this));
+    /* ensure we have the full check interval to be connected */
+    _lastOfferTime = std::chrono::steady_clock::now();
+    if (!_offererConnectionCheckTimer.started())
+    {
+      _offererConnectionCheckTimer.start(_livenessCheckIntervalMs, std::bind(&PeerRelay::_checkConnection, this));
+    }
+  }
+}
+
+void PeerRelay::_createDataChannel(bool negotiated)
+{
+  webrtc::DataChannelInit dataChannelInit;
+  dataChannelInit.ordered = false;
+  dataChannelInit.maxRetransmits = 0;
+  if (negotiated)
+  {
+    dataChannelInit.negotiated = true;
+    dataChannelInit.id = NegotiatedDataChannelId;
+  }
+  _dataChannel = _peerConnection->CreateDataChannel("faf",
+                                                    &dataChannelInit);
+  if (!_dataChannel)
+  {
+    RELAY_LOG_ERROR << "CreateDataChannel() failed";
+    return;
   }
+  _dataChannelNegotiated = negotiated;
+  _dataChannel->RegisterObserver(_dataChannelObserver.get());
+}
+
+void PeerRelay::_onDataChannelOpen()
+{
+  if (!_dataChannelOpenDuration)
+  {
+    _dataChannelOpenDuration = std::chrono::steady_clock::now() - _connectStartTime;
+    RELAY_LOG_INFO << "data channel open after " << std::chrono::duration_cast<std::chrono::milliseconds>(*_dataChannelOpenDuration).count() / 1000.;
+  }
+  _flushReconnectQueue();
 }
 
 void PeerRelay::_setIceState(std::string const& state)
@@ -227,6 +470,7 @@ void PeerRelay::_setConnected(bool connected)
   if (connected != _isConnected)
   {
     _isConnected = connected;
+    EventTrace::record(TraceEvent::Connected, _remotePlayerId, connected ? 1 : 0);
     if (_callbacks.connectedCallback)
     {
       _callbacks.connectedCallback(connected);
@@ -235,9 +479,9 @@ void PeerRelay::_setConnected(bool connected)
     {
       _connectDuration = std::chrono::steady_clock::now() - _connectStartTime;
       RELAY_LOG_INFO << "connected after " <<  std::chrono::duration_cast<std::chrono::milliseconds>(_connectDuration).count() / 1000.;
-      _missedPings = 0;
+      _lastReceivedTime = std::chrono::steady_clock::now();
       _lastSentPingTime.reset();
-      _lastReceivedPongTime.reset();
+      _flushReconnectQueue();
     }
     else
     {
@@ -248,31 +492,397 @@ void PeerRelay::_setConnected(bool connected)
 
 void PeerRelay::_onPeerdataFromGame(rtc::AsyncSocket* socket)
 {
-  _sendCowBuffer.EnsureCapacity(sendBufferSize);
-  auto msgLength = socket->Recv(_sendCowBuffer.data(), sendBufferSize, nullptr);
+  ++_gameReadWakeups;
+  std::size_t batchDatagrams = 0;
+  auto releasedBytes = _dataChannelReleasedBytes();
+  bool drained = false;
+#if defined(WEBRTC_LINUX)
+  /* Drain lockstep bursts with as few syscalls as possible. A DatagramSocket
+   * keeps its read notification enabled, so recvmmsg() alone can drain it. */
+  auto datagramSocket = dynamic_cast<DatagramSocket*>(socket);
+  int fd = datagramSocket ? datagramSocket->GetDescriptor() : -1;
+  drained = fd >= 0;
+  std::array<mmsghdr, readBatchSize> msgs;
+  std::array<iovec, readBatchSize> iovecs;
+  std::array<std::size_t, readBatchSize> bufferIndices;
+  while (fd >= 0)
+  {
+    for (std::size_t i = 0; i < readBatchSize; ++i)
+    {
+      bufferIndices[i] = _sendBufferPool.acquire(releasedBytes);
+      auto& buffer = _sendBufferPool.buffer(bufferIndices[i]);
+      iovecs[i].iov_base = buffer.data();
+      iovecs[i].iov_len = buffer.size();
+      msgs[i] = mmsghdr();
+      msgs[i].msg_hdr.msg_iov = &iovecs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received = recvmmsg(fd, msgs.data(), readBatchSize, MSG_DONTWAIT, nullptr);
+    ++_gameReadSyscalls;
+    for (int i = 0; i < received; ++i)
+    {
+      _forwardGameDatagram(bufferIndices[i], msgs[i].msg_len);
+    }
+    for (std::size_t i = std::max(received, 0); i < readBatchSize; ++i)
+    {
+      _sendBufferPool.release(bufferIndices[i]);
+    }
+    if (received <= 0)
+    {
+      break;
+    }
+    batchDatagrams += std::size_t(received);
+    if (std::size_t(received) < readBatchSize)
+    {
+      break;
+    }
+    releasedBytes = _dataChannelReleasedBytes();
+  }
+#endif
+  /* Recv() re-enables the read notification of other sockets,
+   * so they are drained through it until it would block */
+  while (!drained)
+  {
+    auto bufferIndex = _sendBufferPool.acquire(releasedBytes);
+    auto& buffer = _sendBufferPool.buffer(bufferIndex);
+    auto msgLength = socket->Recv(buffer.data(), buffer.size(), nullptr);
+    ++_gameReadSyscalls;
+    if (msgLength <= 0)
+    {
+      _sendBufferPool.release(bufferIndex);
+      break;
+    }
+    _forwardGameDatagram(bufferIndex, std::size_t(msgLength));
+    ++batchDatagrams;
+    releasedBytes = _dataChannelReleasedBytes();
+  }
+  _gameReadDatagrams += batchDatagrams;
+  _gameReadMaxBatch = std::max(_gameReadMaxBatch, batchDatagrams);
+  _scheduleBundleFlush();
+}
+
+void PeerRelay::_forwardGameDatagram(std::size_t bufferIndex, std::size_t size)
+{
+  _metrics.packetsFromGame->inc();
+  _metrics.bytesFromGame->inc(size);
+  if (!_isConnected ||
+      !_isDataChannelOpen())
+  {
+    if (_reconnectQueue.empty())
+    {
+      RELAY_LOG_TRACE << "skipping " << size << " bytes of P2P data until ICE connection is established";
+      _metrics.droppedNotConnected->inc();
+      EventTrace::record(TraceEvent::PacketFromGame, _remotePlayerId, size, static_cast<uint64_t>(TracePacketAction::Dropped));
+    }
+    else if (size > 0)
+    {
+      auto& buffer = _sendBufferPool.buffer(bufferIndex);
+      buffer.SetSize(size);
+      _queueForReconnect(buffer);
+      EventTrace::record(TraceEvent::PacketFromGame, _remotePlayerId, size, static_cast<uint64_t>(TracePacketAction::Queued));
+    }
+    _sendBufferPool.release(bufferIndex);
+    return;
+  }
+  if (size > 0 && _dataChannel)
+  {
+    auto& buffer = _sendBufferPool.buffer(bufferIndex);
+    buffer.SetSize(size);
+    bool fitsBundle = sizeof(PacketBundle::magic) + PacketBundle::recordHeaderSize + size <= maxBundleSize;
+    if (_bundlingNegotiated() &&
+        (fitsBundle || PacketBundle::hasMagic(buffer.cdata(), size)))
+    {
+      _appendToBundle(buffer);
+      _sendBufferPool.release(bufferIndex);
+      if (!fitsBundle)
+      {
+        /* a single packet bundle escaping a large packet starting with the magic */
+        _flushBundle();
+      }
+      EventTrace::record(TraceEvent::PacketFromGame, _remotePlayerId, size, static_cast<uint64_t>(TracePacketAction::Bundled));
+      return;
+    }
+    /* keep the packet order */
+    _flushBundle();
+    _sendToDataChannel(buffer);
+    EventTrace::record(TraceEvent::PacketFromGame, _remotePlayerId, size, static_cast<uint64_t>(TracePacketAction::Sent));
+    _sendBufferPool.markSent(bufferIndex, _dataChannelBytesSent);
+  }
+  else
+  {
+    _sendBufferPool.release(bufferIndex);
+  }
+}
+
+bool PeerRelay::_bundlingNegotiated() const
+{
+  return _bundlePackets && _remoteSupportsBundles;
+}
+
+void PeerRelay::_appendToBundle(rtc::CopyOnWriteBuffer const& packet)
+{
+  if (_bundleBufferIndex &&
+      _sendBufferPool.buffer(*_bundleBufferIndex).size() + PacketBundle::recordHeaderSize + packet.size() > maxBundleSize)
+  {
+    _flushBundle();
+  }
+  if (!_bundleBufferIndex)
+  {
+    _bundleBufferIndex = _sendBufferPool.acquire(_dataChannelReleasedBytes());
+    auto& bundle = _sendBufferPool.buffer(*_bundleBufferIndex);
+    bundle.SetSize(0);
+    PacketBundle::begin(bundle);
+  }
+  PacketBundle::append(_sendBufferPool.buffer(*_bundleBufferIndex), packet.cdata(), packet.size());
+  ++_bundlePacketCount;
+}
+
+void PeerRelay::_scheduleBundleFlush()
+{
+  if (!_bundleBufferIndex)
+  {
+    return;
+  }
+  if (_bundleWindowUs <= 0)
+  {
+    _flushBundle();
+  }
+  else if (!_bundleTimer.started())
+  {
+    /* the event loop has millisecond resolution */
+    _bundleTimer.start(std::max(1, (_bundleWindowUs + 999) / 1000), std::bind(&PeerRelay::_flushBundle, this));
+  }
+}
+
+void PeerRelay::_flushBundle()
+{
+  _bundleTimer.stop();
+  if (!_bundleBufferIndex)
+  {
+    return;
+  }
+  auto& bundle = _sendBufferPool.buffer(*_bundleBufferIndex);
+  if (_dataChannel)
+  {
+    _sendToDataChannel(bundle);
+    ++_bundlesSent;
+    _bundledPackets += _bundlePacketCount;
+    _bundleFramingBytes += sizeof(PacketBundle::magic) + _bundlePacketCount * PacketBundle::recordHeaderSize;
+    _sendBufferPool.markSent(*_bundleBufferIndex, _dataChannelBytesSent);
+  }
+  else
+  {
+    _sendBufferPool.release(*_bundleBufferIndex);
+  }
+  _bundleBufferIndex.reset();
+  _bundlePacketCount = 0;
+}
+
+void PeerRelay::_initMetrics()
+{
+  auto& registry = MetricsRegistry::global();
+  auto peer = std::to_string(_remotePlayerId);
+  auto packets = [&](const char* direction)
+  {
+    return registry.counter("faf_relay_packets_total",
+                            "Game packets relayed",
+                            MetricsRegistry::labels({{"peer", peer}, {"direction", direction}}));
+  };
+  auto bytes = [&](const char* direction)
+  {
+    return registry.counter("faf_relay_bytes_total",
+                            "Game packet bytes relayed",
+                            MetricsRegistry::labels({{"peer", peer}, {"direction", direction}}));
+  };
+  auto dropped = [&](const char* reason)
+  {
+    return registry.counter("faf_relay_dropped_packets_total",
+                            "Game packets not relayed to the peer",
+                            MetricsRegistry::labels({{"peer", peer}, {"reason", reason}}));
+  };
+  _metrics.packetsFromGame = packets("from_game");
+  _metrics.bytesFromGame = bytes("from_game");
+  _metrics.packetsToGame = packets("to_game");
+  _metrics.bytesToGame = bytes("to_game");
+  _metrics.droppedNotConnected = dropped("not_connected");
+  _metrics.droppedReconnectOverflow = dropped("reconnect_overflow");
+  _metrics.droppedReconnectExpired = dropped("reconnect_expired");
+  _metrics.iceRestarts = registry.counter("faf_relay_ice_restarts_total",
+                                          "Offers with ICE restart",
+                                          MetricsRegistry::labels({{"peer", peer}}));
+  _metrics.rtt = registry.histogram("faf_relay_rtt_seconds",
+                                    "Ping round trip times",
+                                    MetricsRegistry::latencyBuckets(),
+                                    MetricsRegistry::labels({{"peer", peer}}));
+}
+
+Json::Value PeerRelay::_localFeatures() const
+{
+  Json::Value features(Json::arrayValue);
+  features.append(PingSeqFeature);
+  if (_dataChannelNegotiated)
+  {
+    features.append(NegotiatedDataChannelFeature);
+  }
+  if (_bundlePackets)
+  {
+    features.append(BundleFeature);
+  }
+  return features;
+}
+
+void PeerRelay::_setRemoteFeatures(Json::Value const& features)
+{
+  _remoteFeatures.clear();
+  if (features.isArray())
+  {
+    for (std::size_t i = 0; i < features.size(); ++i)
+    {
+      _remoteFeatures.insert(features[Json::ArrayIndex(i)].asString());
+    }
+  }
+  _remoteSupportsBundles = _remoteFeatures.count(BundleFeature) > 0;
+  _remoteSupportsPingSeq = _remoteFeatures.count(PingSeqFeature) > 0;
+  if (_bundlePackets)
+  {
+    RELAY_LOG_INFO << "packet bundling " << (_remoteSupportsBundles ? "enabled" : "not supported by remote peer");
+  }
+}
+
+bool PeerRelay::_isDataChannelOpen() const
+{
+  return _dataChannel &&
+         _dataChannel->state() == webrtc::DataChannelInterface::kOpen;
+}
 
-  if (!_isConnected)
+void PeerRelay::_queueForReconnect(rtc::CopyOnWriteBuffer const& packet)
+{
+  if (_reconnectQueueSize == _reconnectQueue.size())
+  {
+    /* drop the oldest packet, the game will resend it anyway */
+    _reconnectQueueHead = (_reconnectQueueHead + 1) % _reconnectQueue.size();
+    --_reconnectQueueSize;
+    ++_reconnectDroppedOverflow;
+    _metrics.droppedReconnectOverflow->inc();
+  }
+  auto& entry = _reconnectQueue[(_reconnectQueueHead + _reconnectQueueSize) % _reconnectQueue.size()];
+  entry.data.SetData(packet.cdata(), packet.size());
+  entry.time = std::chrono::steady_clock::now();
+  ++_reconnectQueueSize;
+  ++_reconnectQueuedPackets;
+}
+
+void PeerRelay::_flushReconnectQueue()
+{
+  if (_reconnectQueueSize == 0 ||
+      !_isConnected ||
+      !_isDataChannelOpen())
   {
-    RELAY_LOG_TRACE << "skipping " << msgLength << " bytes of P2P data until ICE connection is established";
     return;
   }
-  if (msgLength > 0 && _dataChannel)
+  auto now = std::chrono::steady_clock::now();
+  std::size_t flushed = 0;
+  auto expiredBefore = _reconnectDroppedExpired;
+  while (_reconnectQueueSize > 0)
+  {
+    auto& entry = _reconnectQueue[_reconnectQueueHead];
+    if (now - entry.time > _reconnectQueueMaxAge)
+    {
+      ++_reconnectDroppedExpired;
+      _metrics.droppedReconnectExpired->inc();
+    }
+    else if (_bundlingNegotiated() &&
+             PacketBundle::hasMagic(entry.data.cdata(), entry.data.size()))
+    {
+      /* escaped like in _forwardGameDatagram */
+      _appendToBundle(entry.data);
+      _flushBundle();
+      ++flushed;
+    }
+    else
+    {
+      _sendToDataChannel(entry.data);
+      ++flushed;
+    }
+    _reconnectQueueHead = (_reconnectQueueHead + 1) % _reconnectQueue.size();
+    --_reconnectQueueSize;
+  }
+  _reconnectFlushedPackets += flushed;
+  EventTrace::record(TraceEvent::ReconnectFlushed, _remotePlayerId, flushed, _reconnectDroppedExpired - expiredBefore);
+  RELAY_LOG_INFO << "flushed " << flushed << " game packets queued while reconnecting";
+}
+
+bool PeerRelay::_sendToDataChannel(rtc::CopyOnWriteBuffer const& data)
+{
+  if (!_dataChannel)
+  {
+    return false;
+  }
+  _dataChannelBytesSent += data.size();
+  return _dataChannel->Send(webrtc::DataBuffer(data, true));
+}
+
+uint64_t PeerRelay::_dataChannelReleasedBytes() const
+{
+  /* the data channel queues messages in order, so everything
+   * except the buffered amount has been handed over to SCTP */
+  if (!_dataChannel)
   {
-    /* I hope the buffer doesn't shrink upon SetSize() */
-    _sendCowBuffer.SetSize(msgLength);
-    _dataChannel->Send({_sendCowBuffer, true});
+    return _dataChannelBytesSent;
   }
+  return _dataChannelBytesSent - std::min<uint64_t>(_dataChannelBytesSent, _dataChannel->buffered_amount());
 }
 
 void PeerRelay::_onRemoteMessage(const uint8_t* data, std::size_t size)
 {
+  _lastReceivedTime = std::chrono::steady_clock::now();
+  if (_isOfferer &&
+      size == sizeof(PongMessage) + PingPayloadSize &&
+      std::equal(PongMessage,
+                 PongMessage + sizeof(PongMessage),
+                 data))
+  {
+    const uint8_t* payload = data + sizeof(PongMessage);
+    uint32_t seq = 0;
+    uint64_t sentUs = 0;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      seq |= uint32_t(payload[i]) << (8 * i);
+    }
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+      sentUs |= uint64_t(payload[4 + i]) << (8 * i);
+    }
+    auto rttMs = _pingStats.onPongReceived(seq, sentUs, _lastReceivedTime);
+    if (rttMs)
+    {
+      _onPong(*rttMs);
+    }
+    return;
+  }
   if (_isOfferer &&
       size == sizeof(PongMessage) &&
       std::equal(data,
                  data + sizeof(PongMessage),
                  PongMessage))
   {
-    _lastReceivedPongTime = std::chrono::steady_clock::now();
+    if (_lastSentPingTime)
+    {
+      _onPong(std::chrono::duration_cast<std::chrono::microseconds>(_lastReceivedTime - *_lastSentPingTime).count() / 1000.);
+      _lastSentPingTime.reset();
+    }
+    return;
+  }
+  if (!_isOfferer &&
+      size == sizeof(PingMessage) + PingPayloadSize &&
+      std::equal(PingMessage,
+                 PingMessage + sizeof(PingMessage),
+                 data) &&
+      _dataChannel)
+  {
+    rtc::CopyOnWriteBuffer pong(PongMessage, sizeof(PongMessage), size);
+    pong.AppendData(data + sizeof(PingMessage), PingPayloadSize);
+    _sendToDataChannel(pong);
     return;
   }
   if (!_isOfferer &&
@@ -282,57 +892,155 @@ void PeerRelay::_onRemoteMessage(const uint8_t* data, std::size_t size)
                  PingMessage) &&
       _dataChannel)
   {
-    _dataChannel->Send(webrtc::DataBuffer(rtc::CopyOnWriteBuffer(PongMessage, sizeof(PongMessage)), true));
+    _sendToDataChannel(rtc::CopyOnWriteBuffer(PongMessage, sizeof(PongMessage)));
     return;
   }
+  /* without negotiated bundling a message with the magic is a plain game packet */
+  if (_bundlingNegotiated() &&
+      PacketBundle::hasMagic(data, size))
+  {
+    if (PacketBundle::forEach(data, size, [this](const uint8_t* packet, std::size_t packetSize)
+        {
+          _sendToGame(packet, packetSize);
+        }))
+    {
+      ++_bundlesReceived;
+      return;
+    }
+    RELAY_LOG_WARN << "invalid bundle framing, forwarding " << size << " bytes unmodified";
+  }
+  _sendToGame(data, size);
+}
+
+void PeerRelay::_sendToGame(const uint8_t* data, std::size_t size)
+{
+  EventTrace::record(TraceEvent::PacketToGame, _remotePlayerId, size);
+  _metrics.packetsToGame->inc();
+  _metrics.bytesToGame->inc(size);
   if (_localUdpSocket)
   {
     _localUdpSocket->SendTo(data,
                             size,
                             _gameUdpAddress);
   }
+  else if (_gameSocketPool)
+  {
+    _gameSocketPool->sendToGame(_localGameAddress,
+                                _gameUdpAddress,
+                                data,
+                                size);
+  }
 }
 
 void PeerRelay::_checkConnection()
 {
-  if (_isOfferer)
+  if (!_isOfferer)
+  {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (!isConnected())
   {
-    if (!isConnected())
+    if (now - _lastOfferTime >= std::chrono::milliseconds(_connectionCheckIntervalMs))
     {
       RELAY_LOG_INFO << "_checkConnection: not connected, sending offer";
       _createOffer();
     }
-    else
+    return;
+  }
+  if (!_dataChannel)
+  {
+    return;
+  }
+  auto silence = now - _lastReceivedTime;
+  auto silenceLimit = _silenceLimit();
+  if (silence > silenceLimit)
+  {
+    /* don't interrupt a running ICE restart */
+    if (now - _lastOfferTime >= std::max<std::chrono::steady_clock::duration>(silenceLimit, std::chrono::seconds(2)))
     {
-      if (_lastSentPingTime &&
-          !_lastReceivedPongTime)
-      {
-        ++_missedPings;
-        if (_missedPings == 2)
-        {
-          RELAY_LOG_INFO << "_checkConnection: 2 missed pings, sending offer";
-          _createOffer();
-        }
-      }
-      if (_lastSentPingTime &&
-          _lastReceivedPongTime &&
-          _lastSentPingTime > _lastReceivedPongTime) /* no pong received within _connectionCheckIntervalMs for our last sent ping */
-      {
-        auto pingDurationSeconds = std::chrono::duration_cast<std::chrono::seconds>(*_lastSentPingTime - *_lastReceivedPongTime);
-        if (pingDurationSeconds.count() >= 15)
-        {
-          RELAY_LOG_INFO << "_checkConnection: no pong received for 15 seconds, sending offer";
-          _createOffer();
-        }
-      }
-      if (_dataChannel)
-      {
-        _dataChannel->Send(webrtc::DataBuffer(rtc::CopyOnWriteBuffer(PingMessage, sizeof(PingMessage)), true));
-        _lastSentPingTime = std::chrono::steady_clock::now();
-        _lastReceivedPongTime.reset();
-      }
+      RELAY_LOG_INFO << "_checkConnection: nothing received for "
+                     << std::chrono::duration_cast<std::chrono::milliseconds>(silence).count()
+                     << " ms (limit " << silenceLimit.count() << " ms), sending offer";
+      ++_livenessRestarts;
+      _createOffer();
+    }
+    return;
+  }
+  _pingStats.expire(now);
+  /* only probe an idle link for liveness, game traffic proves the peer is alive */
+  auto probeInterval = std::chrono::milliseconds(_probeIntervalMs);
+  if (silence >= probeInterval &&
+      (!_lastSentPingTime || now - *_lastSentPingTime >= probeInterval))
+  {
+    _sendPing(now);
+  }
+  else if (_remoteSupportsPingSeq &&
+           _rttProbeIntervalMs > 0 &&
+           now - std::max(_lastPingTime, _lastRttSampleTime) >= std::chrono::milliseconds(_rttProbeIntervalMs))
+  {
+    _sendPing(now);
+  }
+}
+
+void PeerRelay::_sendPing(std::chrono::steady_clock::time_point now)
+{
+  if (_remoteSupportsPingSeq)
+  {
+    uint32_t seq = _nextPingSeq++;
+    uint64_t sentUs = PingStats::timestampUs(now);
+    uint8_t payload[PingPayloadSize];
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      payload[i] = uint8_t(seq >> (8 * i));
+    }
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+      payload[4 + i] = uint8_t(sentUs >> (8 * i));
     }
+    rtc::CopyOnWriteBuffer ping(PingMessage, sizeof(PingMessage), sizeof(PingMessage) + PingPayloadSize);
+    ping.AppendData(payload, PingPayloadSize);
+    _sendToDataChannel(ping);
+    _pingStats.onPingSent(seq, now);
+    EventTrace::record(TraceEvent::PingSent, _remotePlayerId, seq, 1);
+  }
+  else
+  {
+    _sendToDataChannel(rtc::CopyOnWriteBuffer(PingMessage, sizeof(PingMessage)));
+    EventTrace::record(TraceEvent::PingSent, _remotePlayerId);
+  }
+  _lastSentPingTime = now;
+  _lastPingTime = now;
+  ++_probesSent;
+}
+
+void PeerRelay::_onPong(double rttMs)
+{
+  EventTrace::record(TraceEvent::PongReceived, _remotePlayerId, static_cast<uint64_t>(rttMs * 1000));
+  _lastRttSampleTime = std::chrono::steady_clock::now();
+  _metrics.rtt->observe(rttMs / 1000.);
+  if (!_smoothedRttMs)
+  {
+    _smoothedRttMs = rttMs;
+    _rttVariationMs = rttMs / 2;
+  }
+  else
+  {
+    _rttVariationMs = 0.75 * _rttVariationMs + 0.25 * std::abs(*_smoothedRttMs - rttMs);
+    _smoothedRttMs = 0.875 * *_smoothedRttMs + 0.125 * rttMs;
+  }
+}
+
+std::chrono::milliseconds PeerRelay::_silenceLimit() const
+{
+  /* The first probe is sent after the probe interval of silence.
+   * Tolerate the loss of two probes before declaring the link dead. */
+  double rtoMs = _initialRtoMs;
+  if (_smoothedRttMs)
+  {
+    rtoMs = std::max<double>(_minRtoMs, *_smoothedRttMs + 4 * _rttVariationMs);
   }
+  return std::chrono::milliseconds(static_cast<int64_t>(3 * _probeIntervalMs + rtoMs));
 }
 
 } // namespace faf
@@ -5,12 +5,17 @@
 #include <chrono>
 #include <optional>
 #include <array>
+#include <set>
+#include <vector>
 
 #include <webrtc/api/peerconnectioninterface.h>
 #include <webrtc/rtc_base/copyonwritebuffer.h>
 
 #include <third_party/json/json.h>
 
+#include "Metrics.h"
+#include "PacketBufferPool.h"
+#include "PingStats.h"
 #include "Timer.h"
 
 namespace faf {
@@ -22,7 +27,14 @@ class SetRemoteDescriptionObserver;
 class PeerConnectionObserver;
 class DataChannelObserver;
 class RTCStatsCollectorCallback;
+class GameSocketPool;
 
+/*! \brief Relays the game packets of one remote peer via a WebRTC data channel
+ *
+ *  A PeerRelay must be created, used and destroyed on the network thread of
+ *  the PeerConnectionFactory. The game socket is bound on this thread and
+ *  the callbacks are called from it.
+ */
 class PeerRelay : public sigslot::has_slots<>
 {
 public:
@@ -40,6 +52,13 @@ public:
     bool isOfferer;
     int gameUdpPort;
     webrtc::PeerConnectionInterface::IceServers iceServers;
+    GameSocketPool* gameSocketPool = nullptr; /*!< shared game sockets, nullptr to bind an own socket */
+    bool bundlePackets = false; /*!< coalesce small game packets if the remote peer supports it */
+    int bundleWindowUs = 0;     /*!< time to wait for more packets, 0 to bundle the packets of one read event */
+    int reconnectBufferPackets = 128; /*!< game packets kept while reconnecting, 0 to drop them */
+    int reconnectBufferMs = 1000;     /*!< maximum age of a kept game packet */
+    bool negotiatedDataChannel = false; /*!< offerer only: create the data channel out-of-band on both peers */
+    int rttProbeIntervalMs = 1000;      /*!< interval of RTT probes while game data flows, 0 to only probe an idle link */
   };
 
   PeerRelay(Options options,
@@ -53,17 +72,52 @@ public:
 
   int localUdpSocketPort() const;
 
+  /** \brief The address the game has to send the packets for the remote peer to
+      */
+  rtc::SocketAddress const& localGameAddress() const;
+
+  /** \brief Forward a packet received by the GameSocketPool
+      */
+  void onGameDatagram(const uint8_t* data, std::size_t size);
+
+  /** \brief Called by the GameSocketPool after all pending packets were read
+      */
+  void onGameDatagramsDone();
+
   Json::Value status() const;
 
   bool isConnected() const;
 
 protected:
   void _createOffer();
+  void _createDataChannel(bool negotiated);
+  void _onDataChannelOpen();
   void _setIceState(std::string const& state);
+  void _addIceCandidate(webrtc::IceCandidateInterface const* candidate);
+  void _onRemoteDescriptionSet(bool success);
   void _setConnected(bool connected);
   void _onPeerdataFromGame(rtc::AsyncSocket* socket);
+  void _forwardGameDatagram(std::size_t bufferIndex, std::size_t size);
+  bool _sendToDataChannel(rtc::CopyOnWriteBuffer const& data);
+  uint64_t _dataChannelReleasedBytes() const;
+  void _sendToGame(const uint8_t* data, std::size_t size);
+  bool _isDataChannelOpen() const;
+  void _queueForReconnect(rtc::CopyOnWriteBuffer const& packet);
+  void _flushReconnectQueue();
+  /** \brief Both peers announced bundling, so messages with the bundle magic are bundles
+      */
+  bool _bundlingNegotiated() const;
+  void _appendToBundle(rtc::CopyOnWriteBuffer const& packet);
+  void _scheduleBundleFlush();
+  void _flushBundle();
+  void _initMetrics();
+  Json::Value _localFeatures() const;
+  void _setRemoteFeatures(Json::Value const& features);
   void _onRemoteMessage(const uint8_t* data, std::size_t size);
   void _checkConnection();
+  void _sendPing(std::chrono::steady_clock::time_point now);
+  void _onPong(double rttMs);
+  std::chrono::milliseconds _silenceLimit() const;
 
   /* runtime objects for WebRTC */
   rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> _pcfactory;
@@ -83,14 +137,75 @@ protected:
   /* local identifying data */
   int _remotePlayerId;
   std::string _remotePlayerLogin;
+  /* streamed by the RELAY_LOG_* macros */
+  std::string _logPrefix;
   bool _isOfferer;
 
   /* game P2P socket data */
   rtc::SocketAddress _gameUdpAddress;
   std::unique_ptr<rtc::AsyncSocket> _localUdpSocket;
+  GameSocketPool* _gameSocketPool{nullptr};
+  rtc::SocketAddress _localGameAddress;
   int _localUdpSocketPort;
   static constexpr const std::size_t sendBufferSize = 2048;
-  rtc::CopyOnWriteBuffer _sendCowBuffer{sendBufferSize};
+  /* number of datagrams drained from the game socket per syscall */
+  static constexpr const std::size_t readBatchSize = 32;
+  static constexpr const std::size_t sendBufferPoolSize = 2 * readBatchSize;
+  /* a read batch and the open bundle are reserved at the same time */
+  static_assert(sendBufferPoolSize > readBatchSize + 1, "the send buffer pool is too small for a read batch");
+  PacketBufferPool _sendBufferPool{sendBufferSize, sendBufferPoolSize};
+  uint64_t _dataChannelBytesSent{0};
+
+  /* small packet bundling */
+  static constexpr const std::size_t maxBundleSize = 1100;
+  bool _bundlePackets;
+  int _bundleWindowUs;
+  bool _remoteSupportsBundles{false};
+  std::optional<std::size_t> _bundleBufferIndex;
+  std::size_t _bundlePacketCount{0};
+  Timer _bundleTimer;
+  uint64_t _bundlesSent{0};
+  uint64_t _bundledPackets{0};
+  uint64_t _bundlesReceived{0};
+  uint64_t _bundleFramingBytes{0};
+
+  /* game packets kept while the relay reconnects */
+  struct QueuedPacket
+  {
+    rtc::CopyOnWriteBuffer data;
+    std::chrono::steady_clock::time_point time;
+  };
+  std::vector<QueuedPacket> _reconnectQueue;
+  std::size_t _reconnectQueueHead{0};
+  std::size_t _reconnectQueueSize{0};
+  std::chrono::milliseconds _reconnectQueueMaxAge;
+  uint64_t _reconnectQueuedPackets{0};
+  uint64_t _reconnectFlushedPackets{0};
+  uint64_t _reconnectDroppedOverflow{0};
+  uint64_t _reconnectDroppedExpired{0};
+
+  /* features announced by the remote peer in its offer/answer */
+  std::set<std::string> _remoteFeatures;
+
+  /* game socket ingest statistics */
+  uint64_t _gameReadWakeups{0};
+  uint64_t _gameReadSyscalls{0};
+  uint64_t _gameReadDatagrams{0};
+  std::size_t _gameReadMaxBatch{0};
+
+  /* exported via the MetricsRegistry, labeled with the remote player id */
+  struct RelayMetrics
+  {
+    std::shared_ptr<Counter> packetsFromGame;
+    std::shared_ptr<Counter> bytesFromGame;
+    std::shared_ptr<Counter> packetsToGame;
+    std::shared_ptr<Counter> bytesToGame;
+    std::shared_ptr<Counter> droppedNotConnected;
+    std::shared_ptr<Counter> droppedReconnectOverflow;
+    std::shared_ptr<Counter> droppedReconnectExpired;
+    std::shared_ptr<Counter> iceRestarts;
+    std::shared_ptr<Histogram> rtt;
+  } _metrics;
 
   /* ICE state data */
   Callbacks _callbacks;
@@ -103,16 +218,48 @@ protected:
   std::string _remoteCandType;
   std::string _localSdp;
   std::string _iceGatheringState{"none"};
+  /* remote candidates received before their offer/answer was applied */
+  static constexpr const std::size_t maxPendingCandidates = 64;
+  bool _remoteDescriptionPending{false};
+  std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> _pendingCandidates;
+  uint64_t _candidatesQueued{0};
+  uint64_t _candidatesAdded{0};
+  uint64_t _candidatesDropped{0};
+  uint64_t _candidatesFailed{0};
   std::string _dataChannelState{"none"};
+  bool _negotiatedDataChannel;
+  bool _dataChannelNegotiated{false};
 
   /* connectivity check data */
   Timer _offererConnectionCheckTimer;
   std::chrono::steady_clock::time_point _connectStartTime;
+  std::chrono::steady_clock::time_point _lastOfferTime;
+  /* any message from the remote peer proves the connection is alive */
+  std::chrono::steady_clock::time_point _lastReceivedTime;
   std::optional<std::chrono::steady_clock::time_point> _lastSentPingTime;
-  std::optional<std::chrono::steady_clock::time_point> _lastReceivedPongTime;
-  unsigned int _missedPings{0};
+  /* smoothed ping round trip time and its variation as in RFC 6298 */
+  std::optional<double> _smoothedRttMs;
+  double _rttVariationMs{0.};
+  uint64_t _probesSent{0};
+  /* sequenced probes with echoed timestamps if the remote peer supports them */
+  bool _remoteSupportsPingSeq{false};
+  uint32_t _nextPingSeq{0};
+  std::chrono::steady_clock::time_point _lastPingTime;
+  std::chrono::steady_clock::time_point _lastRttSampleTime;
+  PingStats _pingStats{std::chrono::milliseconds(2000)};
+  uint64_t _livenessRestarts{0};
+  unsigned int _livenessCheckIntervalMs{100};
+  /* send a probe after this much time without receiving anything */
+  unsigned int _probeIntervalMs{250};
+  unsigned int _minRtoMs{200};
+  unsigned int _initialRtoMs{1000};
+  /* sequenced probes are also sent on a busy link to keep measuring the RTT,
+   * unless a sample arrived within the interval anyway */
+  unsigned int _rttProbeIntervalMs;
+  /* interval between offers while not connected */
   unsigned int _connectionCheckIntervalMs{7000};
   std::chrono::steady_clock::duration _connectDuration;
+  std::optional<std::chrono::steady_clock::duration> _dataChannelOpenDuration;
 
   /* access declarations for observers */
   friend CreateOfferObserver;
@@ -2,6 +2,7 @@
 
 #include <webrtc/api/stats/rtcstats_objects.h>
 
+#include "EventTrace.h"
 #include "logging.h"
 #include "PeerRelay.h"
 
@@ -49,12 +50,16 @@ void CreateAnswerObserver::OnFailure(const std::string &msg)
 void SetLocalDescriptionObserver::OnSuccess()
 {
   OBSERVER_LOG_DEBUG << "SetLocalDescriptionObserver::OnSuccess";
+  EventTrace::record(TraceEvent::LocalDescription,
+                     _relay->_remotePlayerId,
+                     static_cast<uint64_t>(_relay->_isOfferer ? TraceSdpType::Offer : TraceSdpType::Answer));
   if (_relay->_callbacks.iceMessageCallback)
   {
     Json::Value iceMsg;
     std::string sdpString;
     iceMsg["type"] = _relay->_isOfferer ? "offer" : "answer";
     iceMsg["sdp"] = _relay->_localSdp;
+    iceMsg["features"] = _relay->_localFeatures();
     _relay->_callbacks.iceMessageCallback(iceMsg);
   }
 }
@@ -67,6 +72,7 @@ void SetLocalDescriptionObserver::OnFailure(const std::string &msg)
 void SetRemoteDescriptionObserver::OnSuccess()
 {
   OBSERVER_LOG_DEBUG << "SetRemoteDescriptionObserver::OnSuccess";
+  _relay->_onRemoteDescriptionSet(true);
   if (_relay->_peerConnection &&
       !_relay->_isOfferer)
   {
@@ -78,6 +84,7 @@ void SetRemoteDescriptionObserver::OnSuccess()
 void SetRemoteDescriptionObserver::OnFailure(const std::string &msg)
 {
   OBSERVER_LOG_WARN << "SetRemoteDescriptionObserver::OnFailure: " << msg;
+  _relay->_onRemoteDescriptionSet(false);
 }
 
 void PeerConnectionObserver::OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state)
@@ -88,6 +95,7 @@ void PeerConnectionObserver::OnSignalingChange(webrtc::PeerConnectionInterface::
 void PeerConnectionObserver::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state)
 {
   OBSERVER_LOG_DEBUG << "PeerConnectionObserver::OnIceConnectionChange" << static_cast<int>(new_state);
+  EventTrace::record(TraceEvent::IceConnectionState, _relay->_remotePlayerId, static_cast<uint64_t>(new_state));
   switch (new_state)
   {
     case webrtc::PeerConnectionInterface::kIceConnectionNew:
@@ -120,6 +128,7 @@ void PeerConnectionObserver::OnIceConnectionChange(webrtc::PeerConnectionInterfa
 void PeerConnectionObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state)
 {
   OBSERVER_LOG_DEBUG << "PeerConnectionObserver::OnIceGatheringChange" << static_cast<int>(new_state);
+  EventTrace::record(TraceEvent::IceGatheringState, _relay->_remotePlayerId, static_cast<uint64_t>(new_state));
   switch(new_state)
   {
     case webrtc::PeerConnectionInterface::kIceGatheringNew:
@@ -137,6 +146,9 @@ void PeerConnectionObserver::OnIceGatheringChange(webrtc::PeerConnectionInterfac
 void PeerConnectionObserver::OnIceCandidate(const webrtc::IceCandidateInterface *candidate)
 {
   OBSERVER_LOG_DEBUG << "PeerConnectionObserver::OnIceCandidate";
+  EventTrace::record(TraceEvent::LocalCandidate,
+                     _relay->_remotePlayerId,
+                     static_cast<uint64_t>(EventTrace::candidateType(candidate->candidate().type())));
 
   if (_relay->_callbacks.iceMessageCallback)
   {
@@ -179,11 +191,13 @@ void DataChannelObserver::OnStateChange()
 {
   if (_relay->_dataChannel)
   {
+    EventTrace::record(TraceEvent::DataChannelState, _relay->_remotePlayerId, static_cast<uint64_t>(_relay->_dataChannel->state()));
     switch(_relay->_dataChannel->state())
     {
       case webrtc::DataChannelInterface::kOpen:
         OBSERVER_LOG_DEBUG << "DataChannelObserver::OnStateChange to Open";
         _relay->_dataChannelState = "open";
+        _relay->_onDataChannelOpen();
         break;
       case webrtc::DataChannelInterface::kConnecting:
         OBSERVER_LOG_DEBUG << "DataChannelObserver::OnStateChange to Connecting";
@@ -0,0 +1,146 @@
+#include "PingStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace faf {
+
+PingStats::PingStats(std::chrono::milliseconds lossTimeout):
+  _lossTimeout(lossTimeout)
+{
+}
+
+void PingStats::onPingSent(uint32_t seq, Clock::time_point now)
+{
+  auto& probe = _probes[seq % probeWindow];
+  if (probe.pending)
+  {
+    ++_lost;
+  }
+  probe.seq = seq;
+  probe.sentTime = now;
+  probe.pending = true;
+}
+
+std::optional<double> PingStats::onPongReceived(uint32_t seq, uint64_t sentUs, Clock::time_point now)
+{
+  auto& probe = _probes[seq % probeWindow];
+  uint64_t nowUs = timestampUs(now);
+  if (!probe.pending ||
+      probe.seq != seq ||
+      sentUs > nowUs)
+  {
+    ++_latePongs;
+    return {};
+  }
+  probe.pending = false;
+  ++_answered;
+  uint64_t rttUs = nowUs - sentUs;
+  _addSample(rttUs);
+  return rttUs / 1000.;
+}
+
+void PingStats::expire(Clock::time_point now)
+{
+  for (auto& probe : _probes)
+  {
+    if (probe.pending &&
+        now - probe.sentTime > _lossTimeout)
+    {
+      probe.pending = false;
+      ++_lost;
+    }
+  }
+}
+
+uint64_t PingStats::timestampUs(Clock::time_point time)
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count());
+}
+
+double PingStats::lossRate() const
+{
+  if (_answered + _lost == 0)
+  {
+    return 0.;
+  }
+  return double(_lost) / (_answered + _lost);
+}
+
+double PingStats::minMs() const
+{
+  return _samples > 0 ? _minUs / 1000. : 0.;
+}
+
+double PingStats::maxMs() const
+{
+  return _maxUs / 1000.;
+}
+
+double PingStats::percentileMs(double fraction) const
+{
+  if (_samples == 0)
+  {
+    return 0.;
+  }
+  uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(fraction * _samples)));
+  uint64_t count = 0;
+  for (std::size_t i = 0; i < bucketCount; ++i)
+  {
+    count += _buckets[i];
+    if (count >= rank)
+    {
+      double valueUs = std::min<double>(std::max<double>(_bucketMidUs(i), _minUs), _maxUs);
+      return valueUs / 1000.;
+    }
+  }
+  return maxMs();
+}
+
+std::size_t PingStats::_bucket(uint64_t valueUs)
+{
+  if (valueUs < linearBuckets)
+  {
+    return std::size_t(valueUs);
+  }
+  std::size_t exponent = 0;
+  while ((valueUs >> (exponent + 1)) != 0)
+  {
+    ++exponent;
+  }
+  if (exponent > maxExponent)
+  {
+    return bucketCount - 1;
+  }
+  std::size_t subBucket = (valueUs >> (exponent - subBucketBits)) & ((1 << subBucketBits) - 1);
+  return linearBuckets + (exponent - 4) * (1 << subBucketBits) + subBucket;
+}
+
+double PingStats::_bucketMidUs(std::size_t bucket)
+{
+  if (bucket < linearBuckets)
+  {
+    return double(bucket);
+  }
+  std::size_t exponent = 4 + (bucket - linearBuckets) / (1 << subBucketBits);
+  std::size_t subBucket = (bucket - linearBuckets) % (1 << subBucketBits);
+  uint64_t width = uint64_t(1) << (exponent - subBucketBits);
+  uint64_t lower = ((1 << subBucketBits) + subBucket) * width;
+  return lower + width / 2.;
+}
+
+void PingStats::_addSample(uint64_t rttUs)
+{
+  ++_samples;
+  ++_buckets[_bucket(rttUs)];
+  _minUs = std::min(_minUs, rttUs);
+  _maxUs = std::max(_maxUs, rttUs);
+  if (_lastRttUs)
+  {
+    double difference = std::abs(double(rttUs) - double(*_lastRttUs));
+    _jitterUs += (difference - _jitterUs) / 16.;
+  }
+  _lastRttUs = rttUs;
+}
+
+} // namespace faf
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace faf {
+
+/*! \brief Round trip time, jitter and loss statistics of sequenced ping probes
+ *
+ *  The RTT samples are counted in a fixed log-linear histogram with 8 buckets
+ *  per power of two, so percentiles are accurate to about 6% without any
+ *  allocation after construction. Jitter is the interarrival jitter estimator
+ *  of RFC 3550 applied to consecutive RTT samples. A probe counts as lost if
+ *  no pong arrived within the loss timeout.
+ */
+class PingStats
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit PingStats(std::chrono::milliseconds lossTimeout);
+
+  /** \brief Register a sent probe
+      */
+  void onPingSent(uint32_t seq, Clock::time_point now);
+
+  /** \brief Register a received pong
+       \param sentUs: The send timestamp echoed by the remote peer in microseconds
+       \returns The round trip time in ms or nothing if the probe is unknown or already lost
+      */
+  std::optional<double> onPongReceived(uint32_t seq, uint64_t sentUs, Clock::time_point now);
+
+  /** \brief Count the probes without pong for longer than the loss timeout as lost
+      */
+  void expire(Clock::time_point now);
+
+  static uint64_t timestampUs(Clock::time_point time);
+
+  uint64_t samples() const
+  {
+    return _samples;
+  }
+
+  uint64_t lost() const
+  {
+    return _lost;
+  }
+
+  uint64_t latePongs() const
+  {
+    return _latePongs;
+  }
+
+  /** \brief The fraction of resolved probes which were lost
+      */
+  double lossRate() const;
+
+  double minMs() const;
+  double maxMs() const;
+
+  /** \brief The RTT below which the given fraction of the samples lies, e.g. 0.95
+      */
+  double percentileMs(double fraction) const;
+
+  double jitterMs() const
+  {
+    return _jitterUs / 1000.;
+  }
+
+protected:
+  static constexpr const std::size_t linearBuckets = 16;
+  static constexpr const std::size_t subBucketBits = 3;
+  /* values from 2^26 us (~67 s) on are counted in the last bucket */
+  static constexpr const std::size_t maxExponent = 25;
+  static constexpr const std::size_t bucketCount = linearBuckets + (maxExponent - 3) * (1 << subBucketBits);
+  static constexpr const std::size_t probeWindow = 64;
+
+  static std::size_t _bucket(uint64_t valueUs);
+  static double _bucketMidUs(std::size_t bucket);
+  void _addSample(uint64_t rttUs);
+
+  struct Probe
+  {
+    uint32_t seq{0};
+    Clock::time_point sentTime;
+    bool pending{false};
+  };
+
+  Clock::duration _lossTimeout;
+  std::array<uint32_t, bucketCount> _buckets{};
+  std::array<Probe, probeWindow> _probes;
+  uint64_t _samples{0};
+  uint64_t _answered{0};
+  uint64_t _lost{0};
+  uint64_t _latePongs{0};
+  uint64_t _minUs{UINT64_MAX};
+  uint64_t _maxUs{0};
+  std::optional<uint64_t> _lastRttUs;
+  double _jitterUs{0.};
+};
+
+} // namespace faf
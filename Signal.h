@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <webrtc/rtc_base/checks.h>
+
+namespace faf {
+
+/*! \brief Single-threaded replacement for sigslot signals on hot paths
+ *
+ *  Connecting works like sigslot with signal.connect(object, &Class::method),
+ *  but emitting takes no lock and never allocates: a slot is an object pointer,
+ *  the member function pointer and a call trampoline. The receiver has to
+ *  disconnect() itself or outlive the signal, there is no has_slots<> tracking.
+ *  Slots may connect and disconnect while the signal is emitted.
+ *  Must only be used on one thread, which debug builds check.
+ */
+template<class... Args>
+class Signal
+{
+public:
+  Signal() = default;
+  Signal(Signal const&) = delete;
+  Signal& operator=(Signal const&) = delete;
+
+  template<class T, class Method>
+  void connect(T* object, Method method)
+  {
+    static_assert(std::is_member_function_pointer<Method>::value, "Signal slots need a member function");
+    static_assert(sizeof(Method) <= maxMethodSize, "member function pointer too large");
+    _checkThread();
+    Slot slot;
+    slot.object = object;
+    slot.invoke = &Signal::_invoke<T, Method>;
+    std::memcpy(slot.method, &method, sizeof(method));
+    _slots.push_back(slot);
+  }
+
+  /** \brief Remove all slots of object
+      */
+  void disconnect(void const* object)
+  {
+    _checkThread();
+    for (auto& slot : _slots)
+    {
+      if (slot.object == object)
+      {
+        slot.object = nullptr;
+        _disconnected = true;
+      }
+    }
+    _compact();
+  }
+
+  void disconnect_all()
+  {
+    _checkThread();
+    for (auto& slot : _slots)
+    {
+      slot.object = nullptr;
+    }
+    _disconnected = !_slots.empty();
+    _compact();
+  }
+
+  bool empty() const
+  {
+    return _slots.empty();
+  }
+
+  void emit(Args... args)
+  {
+    _checkThread();
+    ++_emitting;
+    /* slots connected while emitting are called by the next emit */
+    for (std::size_t i = 0, count = _slots.size(); i < count; ++i)
+    {
+      /* copied, a slot may connect and reallocate the slots */
+      Slot slot = _slots[i];
+      if (slot.object)
+      {
+        slot.invoke(slot, args...);
+      }
+    }
+    --_emitting;
+    _compact();
+  }
+
+  void operator()(Args... args)
+  {
+    emit(args...);
+  }
+
+protected:
+  static constexpr const std::size_t maxMethodSize = 4 * sizeof(void*);
+
+  struct Slot
+  {
+    void* object;
+    void (*invoke)(Slot const& slot, Args... args);
+    alignas(void*) unsigned char method[maxMethodSize];
+  };
+
+  template<class T, class Method>
+  static void _invoke(Slot const& slot, Args... args)
+  {
+    Method method;
+    std::memcpy(&method, slot.method, sizeof(method));
+    (static_cast<T*>(slot.object)->*method)(args...);
+  }
+
+  void _compact()
+  {
+    if (_emitting == 0 &&
+        _disconnected)
+    {
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < _slots.size(); ++i)
+      {
+        if (_slots[i].object)
+        {
+          _slots[kept++] = _slots[i];
+        }
+      }
+      _slots.resize(kept);
+      _disconnected = false;
+    }
+  }
+
+  void _checkThread()
+  {
+#if RTC_DCHECK_IS_ON
+    if (_thread == std::thread::id())
+    {
+      _thread = std::this_thread::get_id();
+    }
+    RTC_DCHECK(_thread == std::this_thread::get_id()) << "Signal used from more than one thread";
+#endif
+  }
+
+  std::vector<Slot> _slots;
+  int _emitting{0};
+  bool _disconnected{false};
+#if RTC_DCHECK_IS_ON
+  std::thread::id _thread;
+#endif
+};
+
+} // namespace faf
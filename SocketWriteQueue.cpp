@@ -0,0 +1,146 @@
+#include "SocketWriteQueue.h"
+
+#include <algorithm>
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "logging.h"
+
+namespace faf {
+
+SocketWriteQueue::SocketWriteQueue(rtc::AsyncSocket* socket):
+  _socket(socket)
+{
+  _socket->SignalWriteEvent.connect(this, &SocketWriteQueue::_onWriteEvent);
+}
+
+bool SocketWriteQueue::send(const char* data, std::size_t size)
+{
+  if (_failed)
+  {
+    return false;
+  }
+  if (size == 0)
+  {
+    return true;
+  }
+  if (_begin > 0 &&
+      _begin >= _buffer.size() / 2)
+  {
+    _buffer.erase(_buffer.begin(), _buffer.begin() + _begin);
+    _begin = 0;
+  }
+  _buffer.insert(_buffer.end(), data, data + size);
+  _queuedOffset += size;
+  _messageEnds.push_back(_queuedOffset);
+  _maxQueuedBytes = std::max(_maxQueuedBytes, queuedBytes());
+  _maxQueuedMessages = std::max(_maxQueuedMessages, queuedMessages());
+  _scheduleFlush();
+  return true;
+}
+
+void SocketWriteQueue::flush()
+{
+  _flushScheduled = false;
+  while (!_failed &&
+         _begin < _buffer.size())
+  {
+    std::size_t remaining = _buffer.size() - _begin;
+    int sent = _socket->Send(_buffer.data() + _begin, remaining);
+    ++_sendCalls;
+    if (sent < 0)
+    {
+      if (_socket->IsBlocking())
+      {
+        _waitingForWrite = true;
+      }
+      else
+      {
+        FAF_LOG_ERROR << "SocketWriteQueue: Send() failed with error " << _socket->GetError()
+                      << ", dropping " << queuedMessages() << " messages";
+        _failed = true;
+        _buffer.clear();
+        _begin = 0;
+        _messageEnds.clear();
+      }
+      return;
+    }
+    _begin += std::size_t(sent);
+    _sentOffset += uint64_t(sent);
+    while (!_messageEnds.empty() &&
+           _messageEnds.front() <= _sentOffset)
+    {
+      _messageEnds.pop_front();
+      ++_sentMessages;
+    }
+    if (std::size_t(sent) < remaining)
+    {
+      /* the socket buffer is full, the socket signals when it is writable again */
+      ++_shortWrites;
+      _waitingForWrite = true;
+      return;
+    }
+  }
+  _buffer.clear();
+  _begin = 0;
+}
+
+void SocketWriteQueue::OnMessage(rtc::Message* msg)
+{
+  _flushScheduled = false;
+  if (!_waitingForWrite)
+  {
+    flush();
+  }
+}
+
+void SocketWriteQueue::_onWriteEvent(rtc::AsyncSocket* socket)
+{
+  if (_waitingForWrite)
+  {
+    _waitingForWrite = false;
+    flush();
+    if (!_waitingForWrite &&
+        !_failed)
+    {
+      SignalDrained.emit(this);
+    }
+  }
+}
+
+void SocketWriteQueue::_scheduleFlush()
+{
+  if (_flushScheduled ||
+      _waitingForWrite)
+  {
+    return;
+  }
+  _flushScheduled = true;
+  rtc::Thread::Current()->Post(RTC_FROM_HERE, this);
+}
+
+void SocketWriteQueueStats::add(SocketWriteQueue const& queue)
+{
+  queuedMessages += queue.queuedMessages();
+  queuedBytes += queue.queuedBytes();
+  maxQueuedMessages = std::max(maxQueuedMessages, queue.maxQueuedMessages());
+  maxQueuedBytes = std::max(maxQueuedBytes, queue.maxQueuedBytes());
+  sentMessages += queue.sentMessages();
+  sendCalls += queue.sendCalls();
+  shortWrites += queue.shortWrites();
+}
+
+Json::Value SocketWriteQueueStats::toJson() const
+{
+  Json::Value result;
+  result["queued_messages"] = Json::UInt64(queuedMessages);
+  result["queued_bytes"] = Json::UInt64(queuedBytes);
+  result["max_queued_messages"] = Json::UInt64(maxQueuedMessages);
+  result["max_queued_bytes"] = Json::UInt64(maxQueuedBytes);
+  result["sent_messages"] = Json::UInt64(sentMessages);
+  result["send_calls"] = Json::UInt64(sendCalls);
+  result["short_writes"] = Json::UInt64(shortWrites);
+  return result;
+}
+
+} // namespace faf
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <webrtc/rtc_base/asyncsocket.h>
+#include <webrtc/rtc_base/messagehandler.h>
+#include <webrtc/rtc_base/sigslot.h>
+
+#include <third_party/json/json.h>
+
+#include "Signal.h"
+
+namespace faf {
+
+/*! \brief Outbound message queue of a stream socket
+ *
+ *  Messages are appended to one contiguous buffer and written at the end of
+ *  the current event loop iteration, so a burst of messages is written with
+ *  a single Send(). Short writes and EWOULDBLOCK keep the rest queued until
+ *  the socket signals that it is writable again, so a message is never
+ *  truncated.
+ *  Must be used on the thread of the socket.
+ */
+class SocketWriteQueue : public sigslot::has_slots<>, public rtc::MessageHandler
+{
+public:
+  explicit SocketWriteQueue(rtc::AsyncSocket* socket);
+
+  /** \brief Queue a message
+       \returns false if the socket failed and the message was dropped
+      */
+  bool send(const char* data, std::size_t size);
+
+  /** \brief Write as much of the queue as the socket accepts now
+      */
+  void flush();
+
+  std::size_t queuedBytes() const
+  {
+    return _buffer.size() - _begin;
+  }
+
+  std::size_t queuedMessages() const
+  {
+    return _messageEnds.size();
+  }
+
+  std::size_t maxQueuedBytes() const
+  {
+    return _maxQueuedBytes;
+  }
+
+  std::size_t maxQueuedMessages() const
+  {
+    return _maxQueuedMessages;
+  }
+
+  uint64_t sentMessages() const
+  {
+    return _sentMessages;
+  }
+
+  uint64_t sendCalls() const
+  {
+    return _sendCalls;
+  }
+
+  uint64_t shortWrites() const
+  {
+    return _shortWrites;
+  }
+
+  /** \brief The socket didn't accept the whole queue and is not writable yet
+      */
+  bool waitingForWrite() const
+  {
+    return _waitingForWrite;
+  }
+
+  bool failed() const
+  {
+    return _failed;
+  }
+
+  rtc::AsyncSocket* socket() const
+  {
+    return _socket;
+  }
+
+  /* emitted when the queue was written completely after waiting for the socket */
+  Signal<SocketWriteQueue*> SignalDrained;
+
+protected:
+  virtual void OnMessage(rtc::Message* msg) override;
+  void _onWriteEvent(rtc::AsyncSocket* socket);
+  void _scheduleFlush();
+
+  rtc::AsyncSocket* _socket;
+  std::vector<char> _buffer;
+  std::size_t _begin{0};
+  /* stream offsets of the queued message ends */
+  std::deque<uint64_t> _messageEnds;
+  uint64_t _queuedOffset{0};
+  uint64_t _sentOffset{0};
+  bool _flushScheduled{false};
+  bool _waitingForWrite{false};
+  bool _failed{false};
+  std::size_t _maxQueuedBytes{0};
+  std::size_t _maxQueuedMessages{0};
+  uint64_t _sentMessages{0};
+  uint64_t _sendCalls{0};
+  uint64_t _shortWrites{0};
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(SocketWriteQueue);
+};
+
+/*! \brief Statistics summed up over several SocketWriteQueues, the high-water marks are the maximum
+ */
+struct SocketWriteQueueStats
+{
+  void add(SocketWriteQueue const& queue);
+  Json::Value toJson() const;
+
+  std::size_t queuedMessages{0};
+  std::size_t queuedBytes{0};
+  std::size_t maxQueuedMessages{0};
+  std::size_t maxQueuedBytes{0};
+  uint64_t sentMessages{0};
+  uint64_t sendCalls{0};
+  uint64_t shortWrites{0};
+};
+
+} // namespace faf
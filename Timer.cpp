@@ -32,8 +32,7 @@ void Timer::start(int intervalMs, std::function<void()> callback)
   stop();
   _interval = intervalMs;
   _callback = callback;
-  rtc::Thread::Current()->Clear(this);
-  rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, _interval, this);
+  TimerWheel::current().schedule(this, _interval);
 }
 
 bool Timer::started() const
@@ -44,15 +43,17 @@ bool Timer::started() const
 void Timer::stop()
 {
   _callback = std::function<void()>();
-  rtc::Thread::Current()->Clear(this);
+  TimerWheel::current().cancel(this);
 }
 
-void Timer::OnMessage(rtc::Message* msg)
+void Timer::_onTimerExpired()
 {
   if (_callback)
   {
-    _callback();
-    rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, _interval, this);
+    /* re-arm first and keep the callback alive, so it may stop or restart the timer */
+    TimerWheel::current().schedule(this, _interval);
+    auto callback = _callback;
+    callback();
   }
 }
 
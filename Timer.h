@@ -3,11 +3,14 @@
 #include <functional>
 
 #include <webrtc/rtc_base/sigslot.h>
-#include <webrtc/rtc_base/messagehandler.h>
+
+#include "TimerWheel.h"
 
 namespace faf {
 
-class Timer : public rtc::MessageHandler
+/*! \brief Repeating timer on the TimerWheel of the current thread
+ */
+class Timer : public TimerWheel::Entry
 {
 public:
   Timer();
@@ -17,7 +20,7 @@ public:
   bool started() const;
   void stop();
 protected:
-  virtual void OnMessage(rtc::Message* msg) override;
+  virtual void _onTimerExpired() override;
   int _interval;
   std::function<void()> _callback;
 
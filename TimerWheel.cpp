@@ -0,0 +1,245 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <webrtc/rtc_base/thread.h>
+
+namespace faf {
+
+TimerWheel::Entry::~Entry()
+{
+  if (scheduled() &&
+      _wheel)
+  {
+    _wheel->_unlink(this);
+  }
+}
+
+TimerWheel::TimerWheel():
+  _currentTick(_nowTick())
+{
+  for (auto& level : _slots)
+  {
+    for (auto& slot : level)
+    {
+      slot._prev = &slot;
+      slot._next = &slot;
+    }
+  }
+}
+
+TimerWheel::~TimerWheel()
+{
+  for (auto& level : _slots)
+  {
+    for (auto& slot : level)
+    {
+      while (slot._next != &slot)
+      {
+        _unlink(slot._next);
+      }
+      slot._prev = nullptr;
+      slot._next = nullptr;
+    }
+  }
+}
+
+TimerWheel& TimerWheel::current()
+{
+  static thread_local TimerWheel wheel;
+  return wheel;
+}
+
+void TimerWheel::schedule(Entry* entry, int delayMs)
+{
+  cancel(entry);
+  auto now = _nowTick();
+  if (_size == 0)
+  {
+    /* nothing to catch up with */
+    _currentTick = std::max(_currentTick, now);
+  }
+  entry->_wheel = this;
+  /* the clamp keeps the top level from wrapping */
+  entry->_expiry = std::max(now, _currentTick) + static_cast<uint64_t>(std::clamp(delayMs, 1, std::numeric_limits<int>::max()));
+  _link(entry);
+  _scheduleWakeup();
+}
+
+void TimerWheel::cancel(Entry* entry)
+{
+  if (entry->scheduled())
+  {
+    entry->_wheel->_unlink(entry);
+  }
+}
+
+void TimerWheel::OnMessage(rtc::Message* msg)
+{
+  /* the earliest posted wakeup fires first */
+  if (!_wakeups.empty())
+  {
+    _wakeups.erase(_wakeups.begin());
+  }
+  _advance(_nowTick());
+  _scheduleWakeup();
+}
+
+uint64_t TimerWheel::_nowTick()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+void TimerWheel::_link(Entry* entry)
+{
+  uint64_t expiry = std::max(entry->_expiry, _currentTick);
+  uint64_t difference = expiry ^ _currentTick;
+  int level = 0;
+  while (level < levels - 1 &&
+         (difference >> (slotBits * (level + 1))) != 0)
+  {
+    ++level;
+  }
+  int slot = static_cast<int>((expiry >> (slotBits * level)) & (slots - 1));
+  Slot& head = _slots[level][slot];
+  entry->_level = static_cast<uint8_t>(level);
+  entry->_slot = static_cast<uint8_t>(slot);
+  entry->_prev = head._prev;
+  entry->_next = &head;
+  head._prev->_next = entry;
+  head._prev = entry;
+  _occupied[level][slot / 64] |= uint64_t(1) << (slot % 64);
+  ++_size;
+}
+
+void TimerWheel::_unlink(Entry* entry)
+{
+  entry->_prev->_next = entry->_next;
+  entry->_next->_prev = entry->_prev;
+  Slot& head = _slots[entry->_level][entry->_slot];
+  if (head._next == &head)
+  {
+    _occupied[entry->_level][entry->_slot / 64] &= ~(uint64_t(1) << (entry->_slot % 64));
+  }
+  entry->_prev = nullptr;
+  entry->_next = nullptr;
+  --_size;
+}
+
+static int countTrailingZeros(uint64_t word)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
+/* the next occupied slot index after index, or -1 */
+static int nextOccupied(std::array<uint64_t, TimerWheel::slots / 64> const& occupied, int index)
+{
+  for (int slot = index + 1; slot < TimerWheel::slots;)
+  {
+    uint64_t word = occupied[slot / 64] >> (slot % 64);
+    if (word != 0)
+    {
+      return slot + countTrailingZeros(word);
+    }
+    slot = (slot / 64 + 1) * 64;
+  }
+  return -1;
+}
+
+uint64_t TimerWheel::_nextTick() const
+{
+  /* lower levels always expire earlier */
+  for (int level = 0; level < levels; ++level)
+  {
+    int shift = slotBits * level;
+    int index = static_cast<int>((_currentTick >> shift) & (slots - 1));
+    uint64_t windowStart = _currentTick & ~((uint64_t(1) << (shift + slotBits)) - 1);
+    int slot = nextOccupied(_occupied[level], index);
+    if (slot >= 0)
+    {
+      return windowStart | (uint64_t(slot) << shift);
+    }
+    if (level == levels - 1)
+    {
+      /* the top level wraps around */
+      slot = nextOccupied(_occupied[level], -1);
+      if (slot >= 0)
+      {
+        return (windowStart + (uint64_t(1) << (shift + slotBits))) | (uint64_t(slot) << shift);
+      }
+    }
+  }
+  return std::numeric_limits<uint64_t>::max();
+}
+
+void TimerWheel::_advance(uint64_t tick)
+{
+  while (_currentTick < tick)
+  {
+    /* jump over the empty slots */
+    uint64_t next = _nextTick();
+    if (next > tick)
+    {
+      _currentTick = tick;
+      return;
+    }
+    _currentTick = next;
+    for (int level = levels - 1; level > 0; --level)
+    {
+      if ((_currentTick & ((uint64_t(1) << (slotBits * level)) - 1)) == 0)
+      {
+        _cascade(level, static_cast<int>((_currentTick >> (slotBits * level)) & (slots - 1)));
+      }
+    }
+    Slot& head = _slots[0][_currentTick & (slots - 1)];
+    while (head._next != &head)
+    {
+      Entry* entry = head._next;
+      _unlink(entry);
+      entry->_onTimerExpired();
+    }
+  }
+}
+
+void TimerWheel::_cascade(int level, int slot)
+{
+  Slot& head = _slots[level][slot];
+  while (head._next != &head)
+  {
+    Entry* entry = head._next;
+    _unlink(entry);
+    _link(entry);
+  }
+}
+
+void TimerWheel::_scheduleWakeup()
+{
+  if (_size == 0)
+  {
+    return;
+  }
+  uint64_t next = _nextTick();
+  if (!_wakeups.empty() &&
+      _wakeups.front() <= next)
+  {
+    return;
+  }
+  auto now = _nowTick();
+  int delay = next > now ? static_cast<int>(std::min<uint64_t>(next - now, std::numeric_limits<int>::max())) : 0;
+  rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, delay, this);
+  _wakeups.insert(_wakeups.begin(), next);
+}
+
+} // namespace faf
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <webrtc/rtc_base/messagehandler.h>
+
+namespace faf {
+
+/*! \brief Hierarchical timing wheel driving all Timers of a thread
+ *
+ *  Four levels of 256 slots with a resolution of 1 ms. An entry is linked
+ *  into the slot of the highest level its expiry differs from the current
+ *  tick in, and moved down a level when the wheel reaches its slot. Start
+ *  and stop are O(1) list operations, and the wheel needs only one
+ *  delayed message on the rtc::Thread for its next occupied slot instead of
+ *  one per timer, so there is no rtc::Thread::Clear() queue scan.
+ *  Must only be used on its own thread.
+ */
+class TimerWheel : public rtc::MessageHandler
+{
+public:
+  /*! \brief Intrusive node of a scheduled timer
+   */
+  class Entry
+  {
+  public:
+    virtual ~Entry();
+    bool scheduled() const
+    {
+      return _next != nullptr;
+    }
+  protected:
+    virtual void _onTimerExpired() = 0;
+  private:
+    friend class TimerWheel;
+    Entry* _prev{nullptr};
+    Entry* _next{nullptr};
+    TimerWheel* _wheel{nullptr};
+    uint64_t _expiry{0};
+    uint8_t _level{0};
+    uint8_t _slot{0};
+  };
+
+  TimerWheel();
+  virtual ~TimerWheel();
+
+  /** \brief The wheel of the current thread
+      */
+  static TimerWheel& current();
+
+  /** \brief (Re-)schedule entry to expire in delayMs, at least in the next tick
+      */
+  void schedule(Entry* entry, int delayMs);
+  void cancel(Entry* entry);
+
+  std::size_t size() const
+  {
+    return _size;
+  }
+
+  static constexpr const int levels = 4;
+  static constexpr const int slotBits = 8;
+  static constexpr const int slots = 1 << slotBits;
+
+protected:
+  /* circular list sentinel of a slot */
+  class Slot : public Entry
+  {
+  protected:
+    virtual void _onTimerExpired() override {}
+  };
+
+  virtual void OnMessage(rtc::Message* msg) override;
+  static uint64_t _nowTick();
+  void _link(Entry* entry);
+  void _unlink(Entry* entry);
+  uint64_t _nextTick() const;
+  void _advance(uint64_t tick);
+  void _cascade(int level, int slot);
+  void _scheduleWakeup();
+
+  std::array<std::array<Slot, slots>, levels> _slots;
+  /* occupied slots per level */
+  std::array<std::array<uint64_t, slots / 64>, levels> _occupied{};
+  uint64_t _currentTick;
+  std::size_t _size{0};
+  /* ticks of the posted wakeup messages, ascending */
+  std::vector<uint64_t> _wakeups;
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+} // namespace faf
@@ -0,0 +1,162 @@
+#include "UnixSocket.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(WEBRTC_POSIX)
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#  include <webrtc/rtc_base/physicalsocketserver.h>
+#endif
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "logging.h"
+
+namespace faf {
+
+#if defined(WEBRTC_POSIX)
+
+static bool unix_socket_address(std::string const& path, sockaddr_un& addr)
+{
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.empty() ||
+      path.size() >= sizeof(addr.sun_path))
+  {
+    FAF_LOG_ERROR << "invalid UNIX socket path " << path;
+    return false;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+  return true;
+}
+
+/* The descriptor is handed to the PhysicalSocketServer, which makes it non-blocking
+ * and dispatches its events like the ones of the sockets it created itself. */
+static rtc::AsyncSocket* unix_socket_wrap(int fd)
+{
+  auto ss = static_cast<rtc::PhysicalSocketServer*>(rtc::Thread::Current()->socketserver());
+  auto socket = ss->WrapSocket(fd);
+  if (!socket)
+  {
+    ::close(fd);
+  }
+  return socket;
+}
+
+/* only socket files are removed, a mistyped path must not delete anything else */
+static bool unix_socket_remove_stale(std::string const& path)
+{
+  struct stat st;
+  if (::lstat(path.c_str(), &st) != 0)
+  {
+    if (errno == ENOENT)
+    {
+      return true;
+    }
+    FAF_LOG_ERROR << "unable to check UNIX socket path " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  if (!S_ISSOCK(st.st_mode))
+  {
+    FAF_LOG_ERROR << path << " exists and is not a UNIX socket, not replacing it";
+    return false;
+  }
+  if (::unlink(path.c_str()) != 0)
+  {
+    FAF_LOG_ERROR << "unable to remove stale UNIX socket " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+rtc::AsyncSocket* unix_socket_listen(std::string const& path)
+{
+  sockaddr_un addr;
+  if (!unix_socket_address(path, addr))
+  {
+    return nullptr;
+  }
+  if (!unix_socket_remove_stale(path))
+  {
+    return nullptr;
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+  {
+    FAF_LOG_ERROR << "unable to create UNIX socket: " << std::strerror(errno);
+    return nullptr;
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    FAF_LOG_ERROR << "unable to bind UNIX socket " << path << ": " << std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  auto socket = unix_socket_wrap(fd);
+  if (socket &&
+      socket->Listen(5) != 0)
+  {
+    FAF_LOG_ERROR << "unable to listen on UNIX socket " << path;
+    delete socket;
+    return nullptr;
+  }
+  return socket;
+}
+
+rtc::AsyncSocket* unix_socket_connect(std::string const& path)
+{
+  sockaddr_un addr;
+  if (!unix_socket_address(path, addr))
+  {
+    return nullptr;
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+  {
+    FAF_LOG_ERROR << "unable to create UNIX socket: " << std::strerror(errno);
+    return nullptr;
+  }
+  /* connecting to a local listener completes immediately */
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    FAF_LOG_ERROR << "unable to connect to UNIX socket " << path << ": " << std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+  return unix_socket_wrap(fd);
+}
+
+void unix_socket_unlink(std::string const& path)
+{
+  struct stat st;
+  if (::lstat(path.c_str(), &st) == 0 &&
+      S_ISSOCK(st.st_mode))
+  {
+    ::unlink(path.c_str());
+  }
+}
+
+#else
+
+rtc::AsyncSocket* unix_socket_listen(std::string const& path)
+{
+  FAF_LOG_ERROR << "UNIX sockets are not supported on this platform";
+  return nullptr;
+}
+
+rtc::AsyncSocket* unix_socket_connect(std::string const& path)
+{
+  FAF_LOG_ERROR << "UNIX sockets are not supported on this platform";
+  return nullptr;
+}
+
+void unix_socket_unlink(std::string const& path)
+{
+}
+
+#endif
+
+} // namespace faf
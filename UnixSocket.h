@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include <webrtc/rtc_base/asyncsocket.h>
+
+namespace faf {
+
+/** \brief Create an AF_UNIX stream socket listening on path, served by the socket server of the current thread
+     An existing socket file at path is replaced, any other existing file makes it fail.
+     Only supported on POSIX platforms.
+     \returns nullptr on failure
+    */
+rtc::AsyncSocket* unix_socket_listen(std::string const& path);
+
+/** \brief Create an AF_UNIX stream socket connected to path, served by the socket server of the current thread
+     \returns nullptr on failure
+    */
+rtc::AsyncSocket* unix_socket_connect(std::string const& path);
+
+/** \brief Remove the socket file created by unix_socket_listen()
+    */
+void unix_socket_unlink(std::string const& path);
+
+} // namespace faf
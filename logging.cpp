@@ -1,66 +1,137 @@
 #include "logging.h"
 
+#include <cstdlib>
+#include <vector>
+
 #include "webrtc/rtc_base/logging.h"
 #include "webrtc/rtc_base/logsinks.h"
 
+#include "AsyncLogSink.h"
+
 namespace faf
 {
 
-void logging_init(std::string const& verbosity)
+static std::size_t asyncBufferSize = 0;
+static LogOverflowPolicy asyncOverflowPolicy = LogOverflowPolicy::Drop;
+/* never destroyed, logging_stop_async() runs at exit before the rtc logging statics are gone */
+static std::vector<AsyncLogSink*> asyncSinks;
+
+static bool logging_severity(std::string const& verbosity, rtc::LoggingSeverity& severity)
 {
-  rtc::LogMessage::LogTimestamps();
-  rtc::LogMessage::LogThreads();
-  rtc::LogMessage::SetLogToStderr(true);
   if (verbosity == "error")
   {
-    rtc::LogMessage::LogToDebug(rtc::LS_ERROR);
+    severity = rtc::LS_ERROR;
   }
   else if (verbosity == "warn")
   {
-    rtc::LogMessage::LogToDebug(rtc::LS_WARNING);
+    severity = rtc::LS_WARNING;
   }
   else if (verbosity == "info")
   {
-    rtc::LogMessage::LogToDebug(rtc::LS_INFO);
+    severity = rtc::LS_INFO;
   }
   else if (verbosity == "verbose")
   {
-    rtc::LogMessage::LogToDebug(rtc::LS_VERBOSE);
+    severity = rtc::LS_VERBOSE;
   }
   else if (verbosity == "debug")
   {
-    rtc::LogMessage::LogToDebug(rtc::LS_SENSITIVE);
+    severity = rtc::LS_SENSITIVE;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+static void logging_stop_async()
+{
+  for (auto sink : asyncSinks)
+  {
+    rtc::LogMessage::RemoveLogToStream(sink);
+    sink->stop();
+  }
+}
+
+static void logging_add_async_sink(rtc::LogSink* target, rtc::LoggingSeverity severity)
+{
+  if (asyncSinks.empty())
+  {
+    std::atexit(logging_stop_async);
+  }
+  asyncSinks.push_back(new AsyncLogSink(target, asyncBufferSize, asyncOverflowPolicy));
+  rtc::LogMessage::AddLogToStream(asyncSinks.back(), severity);
+}
+
+void logging_set_async(std::size_t bufferSize,
+                       std::string const& overflowPolicy)
+{
+  asyncBufferSize = bufferSize;
+  asyncOverflowPolicy = overflowPolicy == "block" ? LogOverflowPolicy::Block : LogOverflowPolicy::Drop;
+}
+
+void logging_init(std::string const& verbosity)
+{
+  rtc::LogMessage::LogTimestamps();
+  rtc::LogMessage::LogThreads();
+  rtc::LoggingSeverity severity;
+  if (!logging_severity(verbosity, severity))
+  {
+    rtc::LogMessage::SetLogToStderr(true);
+    return;
+  }
+  if (asyncBufferSize > 0)
+  {
+    /* stderr is written by the async sink instead */
+    rtc::LogMessage::SetLogToStderr(false);
+    rtc::LogMessage::LogToDebug(rtc::LS_NONE);
+    logging_add_async_sink(nullptr, severity);
+  }
+  else
+  {
+    rtc::LogMessage::SetLogToStderr(true);
+    rtc::LogMessage::LogToDebug(severity);
   }
 }
 
 void logging_init_log_dir(std::string const& verbosity,
                           std::string const& log_directory)
 {
+  rtc::LoggingSeverity severity;
+  if (asyncBufferSize > 0)
+  {
+    /* only called from the writer thread, outlives it */
+    auto sink = new rtc::FileRotatingLogSink(log_directory,
+                                             "ice_adapter",
+                                             1024*1024,
+                                             2);
+    sink->Init();
+    if (logging_severity(verbosity, severity))
+    {
+      logging_add_async_sink(sink, severity);
+    }
+    return;
+  }
   static rtc::FileRotatingLogSink sink(log_directory,
                                        "ice_adapter",
                                        1024*1024,
                                        2);
   sink.Init();
-  if (verbosity == "error")
-  {
-    rtc::LogMessage::AddLogToStream(&sink, rtc::LS_ERROR);
-  }
-  else if (verbosity == "warn")
-  {
-    rtc::LogMessage::AddLogToStream(&sink, rtc::LS_WARNING);
-  }
-  else if (verbosity == "info")
-  {
-    rtc::LogMessage::AddLogToStream(&sink, rtc::LS_INFO);
-  }
-  else if (verbosity == "verbose")
+  if (logging_severity(verbosity, severity))
   {
-    rtc::LogMessage::AddLogToStream(&sink, rtc::LS_VERBOSE);
+    rtc::LogMessage::AddLogToStream(&sink, severity);
   }
-  else if (verbosity == "debug")
+}
+
+uint64_t logging_dropped_messages()
+{
+  uint64_t result = 0;
+  for (auto sink : asyncSinks)
   {
-    rtc::LogMessage::AddLogToStream(&sink, rtc::LS_SENSITIVE);
+    result += sink->droppedMessages();
   }
+  return result;
 }
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include <webrtc/rtc_base/logging.h>
@@ -7,10 +8,21 @@
 namespace faf
 {
 
+/** \brief Write the log output from background threads through lock-free ring buffers
+     Must be called before logging_init().
+     \param bufferSize: The ring buffer size per output in bytes, 0 to log synchronously
+     \param overflowPolicy: "drop" to drop messages while the buffer is full or "block" to wait
+    */
+void logging_set_async(std::size_t bufferSize,
+                       std::string const& overflowPolicy);
 void logging_init(std::string const& verbosity);
 void logging_init_log_dir(std::string const& verbosity,
                           std::string const& log_directory);
 
+/** \brief The number of messages dropped by the async logging because its buffer was full
+    */
+uint64_t logging_dropped_messages();
+
 #define FAF_LOG_TRACE LOG(LS_SENSITIVE) << "[trace] FAF: "
 #define FAF_LOG_DEBUG LOG(LS_VERBOSE)   << "[debug] FAF: "
 #define FAF_LOG_INFO LOG(LS_INFO)       << "[info] FAF: "
@@ -1,6 +1,8 @@
+#include <algorithm>
 
 #include <webrtc/rtc_base/ssladapter.h>
 
+#include "EventTrace.h"
 #include "IceAdapter.h"
 #include "IceAdapterOptions.h"
 #include "logging.h"
@@ -9,11 +11,16 @@ int main(int argc, char *argv[])
 {
   auto options = faf::IceAdapterOptions::init(argc, argv);
 
+  faf::logging_set_async(std::size_t(std::max(0, options.logBufferKb)) * 1024, options.logOverflow);
   faf::logging_init(options.logLevel);
   if (!options.logDirectory.empty())
   {
     faf::logging_init_log_dir(options.logLevel, options.logDirectory);
   }
+  if (!options.traceFile.empty())
+  {
+    faf::EventTrace::open(options.traceFile, std::size_t(std::max(1, options.traceSizeMb)));
+  }
 
   if (!rtc::InitializeSSL())
   {
@@ -21,11 +28,15 @@ int main(int argc, char *argv[])
     std::exit(1);
   }
 
-  faf::IceAdapter iceAdapter(options);
+  {
+    /* the IceAdapter joins its threads when it is destroyed, they must not record to a closed trace */
+    faf::IceAdapter iceAdapter(options);
 
-  rtc::Thread::Current()->Run();
+    rtc::Thread::Current()->Run();
+  }
 
   rtc::CleanupSSL();
+  faf::EventTrace::close();
 
   return 0;
 }
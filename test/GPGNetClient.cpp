@@ -54,23 +54,21 @@ void GPGNetClient::_onConnected(rtc::AsyncSocket* socket)
 
 void GPGNetClient::_onRead(rtc::AsyncSocket* socket)
 {
-  static char buffer[2048];
-
   int msgLength = 0;
   do
   {
-    msgLength = socket->Recv(buffer, 2048, nullptr);
+    msgLength = socket->Recv(_parser.prepare(2048), 2048, nullptr);
     if (msgLength > 0)
     {
-      _messageBuffer.append(buffer, std::size_t(msgLength));
+      _parser.commit(std::size_t(msgLength));
     }
   }
   while (msgLength > 0);
-  GPGNetMessage::parse(_messageBuffer, [&](const GPGNetMessage& msg)
+  _parser.parse([&](GPGNetMessageView const& view)
   {
     if (_cb)
     {
-      _cb(msg);
+      _cb(GPGNetMessage::fromView(view));
     }
   });
 }
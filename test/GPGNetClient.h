@@ -5,6 +5,8 @@
 
 #include <webrtc/rtc_base/asyncsocket.h>
 
+#include "GPGNetParser.h"
+
 namespace faf {
 
 struct GPGNetMessage;
@@ -34,7 +36,7 @@ protected:
 
   std::unique_ptr<rtc::AsyncSocket> _socket;
   Callback _cb;
-  std::string _messageBuffer;
+  GPGNetParser _parser;
 
   RTC_DISALLOW_COPY_AND_ASSIGN(GPGNetClient);
 };
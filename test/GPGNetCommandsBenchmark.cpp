@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "GPGNetCommands.h"
+#include "GPGNetMessage.h"
+
+static constexpr std::size_t iterations = 1000000;
+
+template<class F>
+static void run(char const* name, F encode)
+{
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < 1000; ++i)
+  {
+    bytes += encode(i);
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    bytes += encode(i);
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / double(iterations) << " ns/message"
+            << " (" << bytes << " bytes)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string const address = "127.0.0.1:60123";
+  std::string const login = "Rhiza";
+
+  /* the typed commands must produce the same bytes as the generic message */
+  {
+    faf::GPGNetMessage createLobby;
+    createLobby.header = "CreateLobby";
+    createLobby.chunks = {0, 6112, login, 3, 1};
+    faf::GPGNetMessage connectToPeer;
+    connectToPeer.header = "ConnectToPeer";
+    connectToPeer.chunks = {address, login, 3};
+    faf::GPGNetMessage ping;
+    ping.header = "ping";
+    if (createLobby.toBinary() != faf::gpgnet::CreateLobby::encode(0, 6112, login, 3, 1) ||
+        connectToPeer.toBinary() != faf::gpgnet::ConnectToPeer::encode(address, login, 3) ||
+        ping.toBinary() != faf::gpgnet::Ping::encode() ||
+        connectToPeer.toDebug() != faf::gpgnet::ConnectToPeer::toDebug(address, login, 3))
+    {
+      std::cerr << "GPGNetCommand encoding differs from GPGNetMessage::toBinary()" << std::endl;
+      return 1;
+    }
+  }
+
+  run("GPGNetMessage::toBinary()", [&](std::size_t i)
+  {
+    faf::GPGNetMessage msg;
+    msg.header = "ConnectToPeer";
+    msg.chunks = {
+      address,
+      login,
+      static_cast<int>(i)
+    };
+    return msg.toBinary().size();
+  });
+
+  run("GPGNetCommand::encode()", [&](std::size_t i)
+  {
+    return faf::gpgnet::ConnectToPeer::encode(address, login, static_cast<int>(i)).size();
+  });
+
+  std::vector<char> buffer(1024);
+  run("GPGNetCommand::write() to a preallocated buffer", [&](std::size_t i)
+  {
+    return std::size_t(faf::gpgnet::ConnectToPeer::write(buffer.data(), address, login, static_cast<int>(i)) - buffer.data());
+  });
+
+  return 0;
+}
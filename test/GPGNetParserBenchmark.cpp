@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "GPGNetMessage.h"
+#include "GPGNetParser.h"
+
+/* The parser before GPGNetParser, kept for comparison */
+static void legacyParse(std::string& msgBuffer, std::function<void (faf::GPGNetMessage const&)> cb)
+{
+  while(true)
+  {
+    auto it = msgBuffer.begin();
+
+    int32_t headerLength;
+    if ((msgBuffer.end() - it) <= sizeof(int32_t))
+    {
+      return;
+    }
+    headerLength = *reinterpret_cast<int32_t*>(&*it);
+    it += sizeof(int32_t);
+    if ((msgBuffer.end() - it) < headerLength)
+    {
+      return;
+    }
+
+    faf::GPGNetMessage message;
+    message.header = std::string(&*it, headerLength);
+    it += headerLength;
+
+    int32_t chunkCount;
+    if ((msgBuffer.end() - it) < sizeof(int32_t))
+    {
+      return;
+    }
+    chunkCount = *reinterpret_cast<int32_t*>(&*it);
+    it += sizeof (int32_t);
+    message.chunks.resize(chunkCount);
+
+    for (int chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+    {
+      int8_t type;
+      if ((msgBuffer.end() - it) < sizeof(int8_t))
+      {
+        return;
+      }
+      type = *reinterpret_cast<int8_t*>(&*it);
+      it += sizeof(int8_t);
+      int32_t length;
+      if ((msgBuffer.end() - it) < sizeof(int32_t))
+      {
+        return;
+      }
+      length = *reinterpret_cast<int32_t*>(&*it);
+      it += sizeof(int32_t);
+
+      if (type == 0)
+      {
+        message.chunks[chunkIndex] = length;
+        continue;
+      }
+
+      if (type != 1)
+      {
+        return;
+      }
+
+      if ((msgBuffer.end() - it) < length)
+      {
+        return;
+      }
+      message.chunks[chunkIndex] = std::string(&*it, length);
+      it += length;
+    }
+
+    cb(message);
+    msgBuffer.erase(msgBuffer.begin(), it);
+  }
+}
+
+static faf::GPGNetMessage makeMessage(std::string const& header, std::vector<faf::GPGNetChunk> const& chunks)
+{
+  faf::GPGNetMessage message;
+  message.header = header;
+  message.chunks = chunks;
+  return message;
+}
+
+/* The messages the game sends while a lobby is set up and launched */
+static std::string lobbyBurst()
+{
+  std::vector<faf::GPGNetMessage> messages;
+  messages.push_back(makeMessage("GameState", {"Idle"}));
+  messages.push_back(makeMessage("GameState", {"Lobby"}));
+  std::vector<std::pair<std::string, std::string>> gameOptions = {
+    {"Slots", "8"}, {"Title", "4v4 setons clutch, no noobs"}, {"ScenarioFile", "/maps/setons_clutch.v0004/setons_clutch_scenario.lua"},
+    {"Victory", "demoralization"}, {"Timeouts", "3"}, {"GameSpeed", "normal"}, {"UnitCap", "1000"},
+    {"CheatsEnabled", "false"}, {"CivilianAlliance", "enemy"}, {"FogOfWar", "explored"},
+    {"NoRushOption", "Off"}, {"PrebuiltUnits", "Off"}, {"RevealCivilians", "Yes"}, {"Score", "no"},
+    {"Share", "ShareUntilDeath"}, {"ShareUnitCap", "allies"}, {"TeamLock", "locked"}, {"TeamSpawn", "fixed"},
+    {"AllowObservers", "false"}, {"RandomMap", "Off"}, {"AutoTeams", "manual"}, {"Ranked", "true"}
+  };
+  for (auto const& option : gameOptions)
+  {
+    messages.push_back(makeMessage("GameOption", {option.first, option.second}));
+  }
+  for (int player = 1; player <= 8; ++player)
+  {
+    messages.push_back(makeMessage("PlayerOption", {player, "Faction", player % 4 + 1}));
+    messages.push_back(makeMessage("PlayerOption", {player, "Color", player}));
+    messages.push_back(makeMessage("PlayerOption", {player, "Team", player % 2 + 2}));
+    messages.push_back(makeMessage("PlayerOption", {player, "StartSpot", player}));
+    messages.push_back(makeMessage("Chat", {"player" + std::to_string(player) + ": gl hf"}));
+  }
+  messages.push_back(makeMessage("GameMods", {"activated", 0}));
+  messages.push_back(makeMessage("GameState", {"Launching"}));
+
+  std::string result;
+  for (auto const& message : messages)
+  {
+    result += message.toBinary();
+  }
+  return result;
+}
+
+static bool equal(std::vector<faf::GPGNetMessage> const& a, std::vector<faf::GPGNetMessage> const& b)
+{
+  if (a.size() != b.size())
+  {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); ++i)
+  {
+    if (a[i].header != b[i].header ||
+        a[i].chunks != b[i].chunks)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static constexpr std::size_t readSize = 2048;
+static constexpr std::size_t iterations = 2000;
+
+template<class F>
+static double run(char const* name, std::size_t messagesPerBurst, F parseBurst)
+{
+  parseBurst();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    parseBurst();
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  double nsPerMessage = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / double(iterations * messagesPerBurst);
+  std::cout << name << ": " << nsPerMessage << " ns/message" << std::endl;
+  return nsPerMessage;
+}
+
+int main(int argc, char *argv[])
+{
+  /* a burst of 10 lobbies arriving at once, read in chunks like GPGNetConnectionHandler */
+  std::string burst;
+  for (int i = 0; i < 10; ++i)
+  {
+    burst += lobbyBurst();
+  }
+
+  std::vector<faf::GPGNetMessage> legacyMessages;
+  std::string legacyBuffer;
+  auto legacy = [&]()
+  {
+    legacyMessages.clear();
+    for (std::size_t pos = 0; pos < burst.size(); pos += readSize)
+    {
+      legacyBuffer.append(burst.data() + pos, std::min(readSize, burst.size() - pos));
+      legacyParse(legacyBuffer, [&](faf::GPGNetMessage const& msg)
+      {
+        legacyMessages.push_back(msg);
+      });
+    }
+  };
+
+  std::vector<faf::GPGNetMessage> parserMessages;
+  faf::GPGNetParser parser;
+  auto streaming = [&]()
+  {
+    parserMessages.clear();
+    for (std::size_t pos = 0; pos < burst.size(); pos += readSize)
+    {
+      parser.append(burst.data() + pos, std::min(readSize, burst.size() - pos));
+      parser.parse([&](faf::GPGNetMessageView const& view)
+      {
+        parserMessages.push_back(faf::GPGNetMessage::fromView(view));
+      });
+    }
+  };
+
+  std::size_t viewCount = 0;
+  auto viewsOnly = [&]()
+  {
+    for (std::size_t pos = 0; pos < burst.size(); pos += readSize)
+    {
+      parser.append(burst.data() + pos, std::min(readSize, burst.size() - pos));
+      parser.parse([&](faf::GPGNetMessageView const& view)
+      {
+        viewCount += view.chunks.size();
+      });
+    }
+  };
+
+  legacy();
+  std::size_t messagesPerBurst = legacyMessages.size();
+  run("legacy parser", messagesPerBurst, legacy);
+  run("GPGNetParser with GPGNetMessage copies", messagesPerBurst, streaming);
+  run("GPGNetParser views only", messagesPerBurst, viewsOnly);
+
+  /* the result must not depend on how the stream is split */
+  for (std::size_t splitSize : {std::size_t(1), std::size_t(3), std::size_t(7), std::size_t(4096)})
+  {
+    parserMessages.clear();
+    for (std::size_t pos = 0; pos < burst.size(); pos += splitSize)
+    {
+      parser.append(burst.data() + pos, std::min(splitSize, burst.size() - pos));
+      parser.parse([&](faf::GPGNetMessageView const& view)
+      {
+        parserMessages.push_back(faf::GPGNetMessage::fromView(view));
+      });
+    }
+    if (!equal(legacyMessages, parserMessages) ||
+        parser.bufferedSize() != 0)
+    {
+      std::cerr << "GPGNetParser result differs from the legacy parser with split size " << splitSize << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -283,8 +283,8 @@ public:
     {
       if (msg.header == "CreateLobby")
       {
-        auto lobbyPort = msg.chunks.at(1).asInt();
-        localId = msg.chunks.at(3).asInt();
+        auto lobbyPort = std::get<int32_t>(msg.chunks.at(1));
+        localId = std::get<int32_t>(msg.chunks.at(3));
         _client->sendMessage({"GameState", {"Lobby"}});
         test.lobbySockets.insert({localId, std::unique_ptr<rtc::AsyncSocket>(rtc::Thread::Current()->socketserver()->CreateAsyncSocket(AF_INET, SOCK_DGRAM))});
         test.lobbySockets.at(localId)->SignalReadEvent.connect(&ldr, &LobbyDataReceiver::onPeerdataToGame);
@@ -299,14 +299,14 @@ public:
         test.clients.at(localId)->connectPeers();
 
         rtc::SocketAddress addr;
-        addr.FromString(msg.chunks[0].asString());
-        test.directedPeerAddresses.insert({{localId, msg.chunks[2].asInt()}, addr});
+        addr.FromString(std::get<std::string>(msg.chunks[0]));
+        test.directedPeerAddresses.insert({{localId, std::get<int32_t>(msg.chunks[2])}, addr});
       }
       else if (msg.header == "ConnectToPeer")
       {
         rtc::SocketAddress addr;
-        addr.FromString(msg.chunks[0].asString());
-        test.directedPeerAddresses.insert({{localId, msg.chunks[2].asInt()}, addr});
+        addr.FromString(std::get<std::string>(msg.chunks[0]));
+        test.directedPeerAddresses.insert({{localId, std::get<int32_t>(msg.chunks[2])}, addr});
       }
     });
 
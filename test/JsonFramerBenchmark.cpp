@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <third_party/json/json.h>
+
+#include "JsonFramer.h"
+#include "trim.h"
+
+/* The framing of JsonRpc before JsonFramer, kept for comparison */
+static Json::Value legacyParseJsonFromMsgBuffer(std::string& msgBuffer)
+{
+  Json::Value result;
+
+  if (msgBuffer.empty())
+  {
+    return result;
+  }
+  if (msgBuffer.at(0) != '{')
+  {
+    msgBuffer.clear();
+    return result;
+  }
+
+  bool inString = false;
+  int braceNestingLevel = 0;
+  std::size_t msgPos = 0;
+
+  for (; msgPos < msgBuffer.size(); ++msgPos)
+  {
+    const char& c = msgBuffer.at(msgPos);
+    if (c == '"')
+    {
+      inString = !inString;
+    }
+
+    if (!inString)
+    {
+      if (c == '{')
+      {
+        ++braceNestingLevel;
+      }
+
+      if (c == '}')
+      {
+        --braceNestingLevel;
+        if (braceNestingLevel < 0)
+        {
+          msgBuffer.clear();
+          return result;
+        }
+
+        if (braceNestingLevel == 0)
+        {
+          Json::Reader reader;
+          if (!reader.parse(std::string(msgBuffer.cbegin(),
+                                        msgBuffer.cbegin() + static_cast<std::string::difference_type>(msgPos + 1)),
+                            result))
+          {
+            msgBuffer.clear();
+            return result;
+          }
+          if (msgPos + 1 >= msgBuffer.size())
+          {
+            msgBuffer.clear();
+          }
+          else
+          {
+            msgBuffer = msgBuffer.substr(msgPos + 1);
+          }
+          return result;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+static void legacyRead(std::string& msgBuffer, std::vector<Json::Value>& messages)
+{
+  while (true)
+  {
+    msgBuffer = faf::trim_whitespace(msgBuffer);
+    if (msgBuffer.empty())
+    {
+      break;
+    }
+    Json::Value json = legacyParseJsonFromMsgBuffer(msgBuffer);
+    if (json.isNull())
+    {
+      break;
+    }
+    messages.push_back(json);
+  }
+}
+
+static void framerRead(faf::JsonFramer& framer, std::vector<Json::Value>& messages)
+{
+  framer.parse([&](const char* begin, const char* end, bool)
+  {
+    Json::Value json;
+    Json::Reader reader;
+    if (reader.parse(begin, end, json, false))
+    {
+      messages.push_back(json);
+    }
+  });
+}
+
+/* an iceMsg request carrying a full offer SDP */
+static std::string iceMsgRequest(int id)
+{
+  std::string sdp = "v=0\r\no=- 4611731400430051336 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"
+                    "a=group:BUNDLE data\r\na=msid-semantic: WMS\r\n"
+                    "m=application 9 DTLS/SCTP 5000\r\nc=IN IP4 0.0.0.0\r\n"
+                    "a=ice-ufrag:F7gI\r\na=ice-pwd:x9cml/YzichV2+XlhiMu8g\r\n"
+                    "a=ice-options:trickle\r\n"
+                    "a=fingerprint:sha-256 D1:2C:BE:AD:C4:F6:64:5C:25:16:11:9C:AF:E7:0F:73:79:36:4E:9C:1E:15:54:39:0C:06:8B:ED:96:86:00:39\r\n"
+                    "a=setup:actpass\r\na=mid:data\r\na=sctpmap:5000 webrtc-datachannel 1024\r\n";
+  for (int i = 0; i < 8; ++i)
+  {
+    sdp += "a=candidate:" + std::to_string(842163049 + i) + " 1 udp 1677729535 93.184.216." + std::to_string(i) +
+           " 5" + std::to_string(1000 + i) + " typ srflx raddr 192.168.1.2 rport 5" + std::to_string(1000 + i) + " generation 0\r\n";
+  }
+  Json::Value msg;
+  msg["type"] = "offer";
+  msg["sdp"] = sdp;
+  msg["features"].append("bundle");
+  /* a login with escaped quotes and braces must not break the framing */
+  msg["login"] = "\"}{\\\"";
+  Json::Value request;
+  request["jsonrpc"] = "2.0";
+  request["method"] = "iceMsg";
+  request["params"].append(id);
+  request["params"].append(msg);
+  request["id"] = id;
+  return Json::FastWriter().write(request);
+}
+
+static constexpr std::size_t readSize = 2048;
+static constexpr std::size_t iterations = 200;
+
+int main(int argc, char *argv[])
+{
+  std::string burst;
+  for (int i = 0; i < 12; ++i)
+  {
+    burst += iceMsgRequest(i);
+  }
+
+  /* correctness for every split size, the legacy framer fails on the escaped quotes */
+  for (std::size_t splitSize : {std::size_t(1), std::size_t(5), std::size_t(readSize), burst.size()})
+  {
+    faf::JsonFramer framer;
+    std::vector<Json::Value> messages;
+    for (std::size_t pos = 0; pos < burst.size(); pos += splitSize)
+    {
+      framer.append(burst.data() + pos, std::min(splitSize, burst.size() - pos));
+      framerRead(framer, messages);
+    }
+    if (messages.size() != 12 ||
+        messages[11]["id"].asInt() != 11 ||
+        messages[11]["params"][1]["login"].asString() != "\"}{\\\"" ||
+        framer.bufferedSize() != 0)
+    {
+      std::cerr << "JsonFramer failed with split size " << splitSize << std::endl;
+      return 1;
+    }
+  }
+
+  auto run = [](char const* name, std::string const& data, std::size_t splitSize, auto readChunk)
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::size_t messages = 0;
+    for (std::size_t i = 0; i < iterations; ++i)
+    {
+      messages += readChunk(data, splitSize);
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / double(iterations) << " us for "
+              << messages / iterations << " messages, " << data.size() << " bytes in reads of " << std::min(splitSize, data.size()) << " bytes" << std::endl;
+  };
+
+  auto legacy = [](std::string const& data, std::size_t splitSize)
+  {
+    std::string msgBuffer;
+    std::vector<Json::Value> messages;
+    for (std::size_t pos = 0; pos < data.size(); pos += splitSize)
+    {
+      msgBuffer.append(data.data() + pos, std::min(splitSize, data.size() - pos));
+      legacyRead(msgBuffer, messages);
+    }
+    return messages.size();
+  };
+
+  auto streaming = [](std::string const& data, std::size_t splitSize)
+  {
+    faf::JsonFramer framer;
+    std::vector<Json::Value> messages;
+    for (std::size_t pos = 0; pos < data.size(); pos += splitSize)
+    {
+      framer.append(data.data() + pos, std::min(splitSize, data.size() - pos));
+      framerRead(framer, messages);
+    }
+    return messages.size();
+  };
+
+  /* the legacy framer can't handle the escaped quotes, compare without them */
+  std::string plainBurst = burst;
+  std::string escaped = "\\\"}{\\\\\\\"";
+  for (auto pos = plainBurst.find(escaped); pos != std::string::npos; pos = plainBurst.find(escaped))
+  {
+    plainBurst.replace(pos, escaped.size(), "Rhiza");
+  }
+  std::string largeBurst;
+  for (int i = 0; i < 16; ++i)
+  {
+    largeBurst += plainBurst;
+  }
+
+  run("legacy framing", plainBurst, readSize, legacy);
+  run("JsonFramer    ", plainBurst, readSize, streaming);
+  run("legacy framing", plainBurst, 256, legacy);
+  run("JsonFramer    ", plainBurst, 256, streaming);
+  run("legacy framing", largeBurst, largeBurst.size(), legacy);
+  run("JsonFramer    ", largeBurst, largeBurst.size(), streaming);
+
+  return 0;
+}
@@ -27,6 +27,7 @@ void JsonRpcClient::disconnect()
     _socket->Close();
   }
   _socket.reset(nullptr);
+  _failPendingRequests(nullptr, "connection closed");
 }
 
 bool JsonRpcClient::isConnected() const
@@ -60,7 +61,7 @@ int JsonRpcClient::GetDescriptor()
 }
 #endif
 
-bool JsonRpcClient::_sendMessage(std::string const& message, rtc::AsyncSocket* socket)
+bool JsonRpcClient::_sendMessage(Json::Value const& message, rtc::AsyncSocket* socket)
 {
   if (!_socket)
   {
@@ -73,7 +74,8 @@ bool JsonRpcClient::_sendMessage(std::string const& message, rtc::AsyncSocket* s
   }
   if (_socket->GetState() == rtc::AsyncSocket::CS_CONNECTED)
   {
-    _socket->Send(message.c_str(), message.size());
+    std::string data = _encode(message, _encoding(_socket.get()));
+    _socket->Send(data.c_str(), data.size());
     return true;
   }
   return false;
@@ -91,6 +93,7 @@ void JsonRpcClient::_onRead(rtc::AsyncSocket* socket)
 
 void JsonRpcClient::_onDisconnected(rtc::AsyncSocket* socket, int)
 {
+  _failPendingRequests(nullptr, "connection closed");
   SignalDisconnected.emit(_socket.get());
 }
 
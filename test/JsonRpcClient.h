@@ -27,7 +27,7 @@ public:
 #endif
 
 protected:
-  virtual bool _sendMessage(std::string const& message, rtc::AsyncSocket* socket) override;
+  virtual bool _sendMessage(Json::Value const& message, rtc::AsyncSocket* socket) override;
 
   void _onConnected(rtc::AsyncSocket* socket);
   void _onRead(rtc::AsyncSocket* socket);
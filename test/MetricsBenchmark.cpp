@@ -0,0 +1,123 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <third_party/json/json.h>
+
+#include "Metrics.h"
+
+/* the per relay metrics of PeerRelay::_initMetrics */
+struct RelayMetrics
+{
+  explicit RelayMetrics(int peer)
+  {
+    auto& registry = faf::MetricsRegistry::global();
+    auto id = std::to_string(peer);
+    packets = registry.counter("faf_relay_packets_total", "Game packets relayed",
+                               faf::MetricsRegistry::labels({{"peer", id}, {"direction", "from_game"}}));
+    bytes = registry.counter("faf_relay_bytes_total", "Game packet bytes relayed",
+                             faf::MetricsRegistry::labels({{"peer", id}, {"direction", "from_game"}}));
+    dropped = registry.counter("faf_relay_dropped_packets_total", "Game packets not relayed to the peer",
+                               faf::MetricsRegistry::labels({{"peer", id}, {"reason", "not_connected"}}));
+    rtt = registry.histogram("faf_relay_rtt_seconds", "Ping round trip times",
+                             faf::MetricsRegistry::latencyBuckets(),
+                             faf::MetricsRegistry::labels({{"peer", id}}));
+  }
+
+  std::shared_ptr<faf::Counter> packets;
+  std::shared_ptr<faf::Counter> bytes;
+  std::shared_ptr<faf::Counter> dropped;
+  std::shared_ptr<faf::Histogram> rtt;
+};
+
+static constexpr int iterations = 1000000;
+static constexpr int relays = 16;
+static constexpr int scrapes = 1000;
+
+template<class Function>
+static double measureNs(int count, Function&& function)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i)
+  {
+    function(i);
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / double(count);
+}
+
+/* a status() shaped tree with the same numbers, as polled via JSON-RPC */
+static std::string statusJson(std::vector<RelayMetrics> const& metrics)
+{
+  Json::Value result;
+  result["relays"] = Json::Value(Json::arrayValue);
+  for (std::size_t i = 0; i < metrics.size(); ++i)
+  {
+    Json::Value relay;
+    relay["remote_player_id"] = int(i);
+    relay["game_packets"]["from_game"] = Json::UInt64(metrics[i].packets->value());
+    relay["game_packets"]["from_game_bytes"] = Json::UInt64(metrics[i].bytes->value());
+    relay["game_packets"]["dropped"] = Json::UInt64(metrics[i].dropped->value());
+    relay["ice"]["rtt_sum"] = metrics[i].rtt->sum();
+    for (std::size_t b = 0; b <= metrics[i].rtt->bounds().size(); ++b)
+    {
+      relay["ice"]["rtt_buckets"].append(Json::UInt64(metrics[i].rtt->bucketCount(b)));
+    }
+    result["relays"].append(relay);
+  }
+  return Json::FastWriter().write(result);
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<RelayMetrics> metrics;
+  for (int i = 0; i < relays; ++i)
+  {
+    metrics.emplace_back(i);
+  }
+
+  auto incNs = measureNs(iterations, [&](int i)
+  {
+    auto& relay = metrics[i % relays];
+    relay.packets->inc();
+    relay.bytes->inc(100);
+  });
+  auto observeNs = measureNs(iterations, [&](int i)
+  {
+    metrics[i % relays].rtt->observe((i % 200) / 1000.);
+  });
+
+  /* updates from a second thread while scraping, as from the network thread */
+  std::atomic<bool> stop{false};
+  std::thread updater([&]()
+  {
+    uint64_t i = 0;
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      metrics[i++ % relays].packets->inc();
+    }
+  });
+  std::size_t renderedSize = 0;
+  auto renderUs = measureNs(scrapes, [&](int)
+  {
+    renderedSize = faf::MetricsRegistry::global().render().size();
+  }) / 1000.;
+  std::size_t jsonSize = 0;
+  auto jsonUs = measureNs(scrapes, [&](int)
+  {
+    jsonSize = statusJson(metrics).size();
+  }) / 1000.;
+  stop = true;
+  updater.join();
+
+  std::cout << "counter update (2 counters):   " << incNs << " ns" << std::endl;
+  std::cout << "histogram observe:             " << observeNs << " ns" << std::endl;
+  std::cout << "render " << relays << " relays (" << renderedSize << " bytes): " << renderUs << " us" << std::endl;
+  std::cout << "status json (" << jsonSize << " bytes):       " << jsonUs << " us" << std::endl;
+  return 0;
+}
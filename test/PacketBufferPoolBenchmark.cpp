@@ -0,0 +1,146 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <webrtc/rtc_base/copyonwritebuffer.h>
+
+#include "PacketBufferPool.h"
+
+/* count every heap allocation of the process */
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(std::size_t size)
+{
+  ++allocationCount;
+  if (auto p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+static constexpr std::size_t packetSize = 2048;
+static constexpr std::size_t packetCount = 1000000;
+
+/* Simulates the data channel: up to queueDepth sent messages stay referenced
+ * until they are handed over to SCTP in order. */
+template<std::size_t queueDepth>
+class FakeDataChannel
+{
+public:
+  void send(rtc::CopyOnWriteBuffer const& buffer)
+  {
+    if (_queued == queueDepth)
+    {
+      _released += _queue[_head].size();
+      _queue[_head] = rtc::CopyOnWriteBuffer();
+      _head = (_head + 1) % queueDepth;
+      --_queued;
+    }
+    _queue[(_head + _queued) % queueDepth] = buffer;
+    ++_queued;
+    _sent += buffer.size();
+  }
+
+  uint64_t releasedBytes() const
+  {
+    return _released;
+  }
+
+  uint64_t sentBytes() const
+  {
+    return _sent;
+  }
+
+protected:
+  std::array<rtc::CopyOnWriteBuffer, queueDepth> _queue;
+  std::size_t _head{0};
+  std::size_t _queued{0};
+  uint64_t _released{0};
+  uint64_t _sent{0};
+};
+
+static void fillPacket(uint8_t* data, std::size_t i)
+{
+  data[0] = static_cast<uint8_t>(i);
+  data[1] = static_cast<uint8_t>(i >> 8);
+}
+
+static std::size_t packetLength(std::size_t i)
+{
+  return 16 + (i % 200);
+}
+
+template<class F>
+static double run(char const* name, F forward)
+{
+  for (std::size_t i = 0; i < 1000; ++i)
+  {
+    forward(i);
+  }
+  auto allocationsBefore = allocationCount.load();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < packetCount; ++i)
+  {
+    forward(i);
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  auto allocations = allocationCount.load() - allocationsBefore;
+  double allocationsPerPacket = double(allocations) / packetCount;
+  std::cout << name << ": "
+            << allocationsPerPacket << " allocations/packet, "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / double(packetCount) << " ns/packet"
+            << std::endl;
+  return allocationsPerPacket;
+}
+
+int main(int argc, char *argv[])
+{
+  {
+    /* the former single shared copy-on-write buffer */
+    FakeDataChannel<8> channel;
+    rtc::CopyOnWriteBuffer sendBuffer(packetSize);
+    run("shared buffer", [&](std::size_t i)
+    {
+      sendBuffer.EnsureCapacity(packetSize);
+      fillPacket(sendBuffer.data(), i);
+      sendBuffer.SetSize(packetLength(i));
+      channel.send(sendBuffer);
+    });
+  }
+
+  double pooledAllocations;
+  {
+    FakeDataChannel<8> channel;
+    faf::PacketBufferPool pool(packetSize, 64);
+    pooledAllocations = run("buffer pool", [&](std::size_t i)
+    {
+      auto index = pool.acquire(channel.releasedBytes());
+      auto& buffer = pool.buffer(index);
+      fillPacket(buffer.data(), i);
+      buffer.SetSize(packetLength(i));
+      channel.send(buffer);
+      pool.markSent(index, channel.sentBytes());
+    });
+  }
+
+  if (pooledAllocations > 0)
+  {
+    std::cerr << "forwarding through the buffer pool allocates" << std::endl;
+    return 1;
+  }
+  return 0;
+}
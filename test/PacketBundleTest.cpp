@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PacketBundle.h"
+
+/* the part of rtc::CopyOnWriteBuffer used by PacketBundle */
+struct Buffer
+{
+  void AppendData(const uint8_t* data, std::size_t size)
+  {
+    bytes.insert(bytes.end(), data, data + size);
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+static int failures = 0;
+
+static void check(bool condition, std::string const& what)
+{
+  if (!condition)
+  {
+    std::cerr << "FAILED: " << what << std::endl;
+    ++failures;
+  }
+}
+
+static std::vector<uint8_t> bytes(std::string const& s)
+{
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+static Buffer bundle(std::vector<std::vector<uint8_t>> const& packets)
+{
+  Buffer result;
+  faf::PacketBundle::begin(result);
+  for (auto const& packet : packets)
+  {
+    faf::PacketBundle::append(result, packet.data(), packet.size());
+  }
+  return result;
+}
+
+static std::vector<std::vector<uint8_t>> unbundle(std::vector<uint8_t> const& message, bool& valid)
+{
+  std::vector<std::vector<uint8_t>> result;
+  valid = faf::PacketBundle::forEach(message.data(), message.size(), [&result](const uint8_t* packet, std::size_t size)
+  {
+    result.emplace_back(packet, packet + size);
+  });
+  return result;
+}
+
+int main(int argc, char *argv[])
+{
+  bool valid = false;
+
+  /* several packets survive the round trip in order */
+  {
+    std::vector<std::vector<uint8_t>> packets{bytes("first"), bytes(""), bytes(std::string(300, 'x'))};
+    auto received = unbundle(bundle(packets).bytes, valid);
+    check(valid && received == packets, "round trip of several packets");
+  }
+
+  /* a game packet starting with the magic is escaped as a single packet bundle */
+  {
+    auto packet = bytes("FAFB game payload");
+    check(faf::PacketBundle::hasMagic(packet.data(), packet.size()), "game payload starting with the magic is detected");
+    auto received = unbundle(bundle({packet}).bytes, valid);
+    check(valid && received.size() == 1 && received[0] == packet, "escaped game payload starting with the magic");
+  }
+
+  /* a game packet which is just the magic */
+  {
+    auto packet = bytes("FAFB");
+    auto received = unbundle(bundle({packet}).bytes, valid);
+    check(valid && received.size() == 1 && received[0] == packet, "escaped game payload consisting of the magic");
+  }
+
+  /* an unescaped game payload can look like a valid bundle, which is why
+   * PeerRelay only unbundles with negotiated bundling and escapes then */
+  {
+    std::vector<uint8_t> packet{'F', 'A', 'F', 'B', 1, 0, 'x'};
+    auto received = unbundle(packet, valid);
+    check(valid && received.size() == 1 && received[0] == bytes("x"), "unescaped payload parses as bundle");
+  }
+
+  /* invalid framing is rejected without any callback */
+  {
+    auto packet = bytes("FAFB game payload");
+    auto received = unbundle(packet, valid);
+    check(!valid && received.empty(), "invalid framing is rejected");
+    auto plain = bytes("FAF");
+    unbundle(plain, valid);
+    check(!valid, "message shorter than the magic is rejected");
+  }
+
+  if (failures > 0)
+  {
+    return 1;
+  }
+  std::cout << "all PacketBundle tests passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,174 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <third_party/json/json.h>
+
+#include "CborCodec.h"
+#include "JsonFramer.h"
+
+static Json::Value gpgNetMessageNotification()
+{
+  Json::Value chunks(Json::arrayValue);
+  chunks.append("Lobby");
+  Json::Value params(Json::arrayValue);
+  params.append("GameState");
+  params.append(chunks);
+  Json::Value request;
+  request["jsonrpc"] = "2.0";
+  request["method"] = "onGpgNetMessageReceived";
+  request["params"] = params;
+  return request;
+}
+
+static Json::Value iceMsgNotification()
+{
+  std::string sdp = "v=0\r\no=- 4611731400430051336 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"
+                    "a=group:BUNDLE data\r\na=msid-semantic: WMS\r\n"
+                    "m=application 9 DTLS/SCTP 5000\r\nc=IN IP4 0.0.0.0\r\n"
+                    "a=ice-ufrag:F7gI\r\na=ice-pwd:x9cml/YzichV2+XlhiMu8g\r\n"
+                    "a=ice-options:trickle\r\n"
+                    "a=fingerprint:sha-256 D1:2C:BE:AD:C4:F6:64:5C:25:16:11:9C:AF:E7:0F:73:79:36:4E:9C:1E:15:54:39:0C:06:8B:ED:96:86:00:39\r\n"
+                    "a=setup:actpass\r\na=mid:data\r\na=sctpmap:5000 webrtc-datachannel 1024\r\n";
+  Json::Value msg;
+  msg["type"] = "offer";
+  msg["sdp"] = sdp;
+  msg["features"].append("ping_seq");
+  msg["features"].append("bundle");
+  Json::Value params(Json::arrayValue);
+  params.append(1);
+  params.append(2);
+  params.append(msg);
+  Json::Value request;
+  request["jsonrpc"] = "2.0";
+  request["method"] = "onIceMsg";
+  request["params"] = params;
+  return request;
+}
+
+/* a status response with 15 relays, shaped like IceAdapter::status() */
+static Json::Value statusResponse()
+{
+  Json::Value result;
+  result["version"] = "1.0.0";
+  result["ice_servers_size"] = 3;
+  result["lobby_port"] = 6112;
+  result["init_mode"] = "normal";
+  result["options"]["player_id"] = 1;
+  result["options"]["player_login"] = "Rhiza";
+  result["options"]["rpc_port"] = 7236;
+  result["options"]["gpgnet_port"] = 7237;
+  result["gpgnet"]["connected"] = true;
+  result["gpgnet"]["game_state"] = "Lobby";
+  result["relays"] = Json::Value(Json::arrayValue);
+  for (int i = 0; i < 15; ++i)
+  {
+    Json::Value relay;
+    relay["remote_player_id"] = 100 + i;
+    relay["remote_player_login"] = "Player" + std::to_string(i);
+    relay["local_game_udp_port"] = 50000 + i;
+    relay["ice"]["offerer"] = i % 2 == 0;
+    relay["ice"]["state"] = "connected";
+    relay["ice"]["gathering_state"] = "complete";
+    relay["ice"]["datachannel_state"] = "open";
+    relay["ice"]["connected"] = true;
+    relay["ice"]["loc_cand_addr"] = "192.168.1.2:5" + std::to_string(1000 + i);
+    relay["ice"]["rem_cand_addr"] = "93.184.216." + std::to_string(i) + ":5" + std::to_string(2000 + i);
+    relay["ice"]["loc_cand_type"] = "host";
+    relay["ice"]["rem_cand_type"] = "srflx";
+    relay["ice"]["time_to_connected"] = 0.412 + i;
+    relay["ice"]["smoothed_rtt_ms"] = 31.25 + i;
+    relay["ice"]["rtt_jitter_ms"] = 1.7 + i / 10.0;
+    relay["ice"]["rtt_samples"] = 1200 + i;
+    relay["ice"]["pings_lost"] = i;
+    relay["ice"]["ping_loss_rate"] = i / 1200.0;
+    relay["ice"]["bytes_sent"] = Json::Int64(123456789) * (i + 1);
+    relay["ice"]["bytes_received"] = Json::Int64(98765432) * (i + 1);
+    result["relays"].append(relay);
+  }
+  Json::Value response;
+  response["jsonrpc"] = "2.0";
+  response["id"] = 42;
+  response["result"] = result;
+  return response;
+}
+
+static std::string encodeCbor(Json::Value const& message)
+{
+  std::string result(faf::JsonFramer::binaryHeaderSize, '\0');
+  faf::CborCodec::encode(message, result);
+  faf::JsonFramer::writeBinaryHeader(&result[0], result.size() - faf::JsonFramer::binaryHeaderSize);
+  return result;
+}
+
+static constexpr std::size_t iterations = 2000;
+
+template<class Function>
+static double measureUs(Function&& function)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+  {
+    function();
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 1000.0 / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::pair<const char*, Json::Value>> messages{
+    {"onGpgNetMessageReceived", gpgNetMessageNotification()},
+    {"onIceMsg", iceMsgNotification()},
+    {"status response", statusResponse()}
+  };
+
+  for (auto const& message : messages)
+  {
+    std::string json = Json::FastWriter().write(message.second);
+    std::string cbor = encodeCbor(message.second);
+
+    /* both encodings must go through the framer and decode to the same value */
+    faf::JsonFramer framer;
+    framer.append(json.data(), json.size());
+    framer.append(cbor.data(), cbor.size());
+    std::vector<Json::Value> decoded;
+    framer.parse([&](const char* begin, const char* end, bool binary)
+    {
+      Json::Value value;
+      bool ok = binary ? faf::CborCodec::decode(begin, end, value) :
+                         Json::Reader().parse(begin, end, value, false);
+      if (ok)
+      {
+        decoded.push_back(value);
+      }
+    });
+    if (decoded.size() != 2 ||
+        decoded[0] != message.second ||
+        decoded[1] != message.second)
+    {
+      std::cerr << "round trip of " << message.first << " failed" << std::endl;
+      return 1;
+    }
+
+    double jsonEncode = measureUs([&]() { Json::FastWriter().write(message.second); });
+    double cborEncode = measureUs([&]() { encodeCbor(message.second); });
+    double jsonDecode = measureUs([&]()
+    {
+      Json::Value value;
+      Json::Reader().parse(json.data(), json.data() + json.size(), value, false);
+    });
+    double cborDecode = measureUs([&]()
+    {
+      Json::Value value;
+      faf::CborCodec::decode(cbor.data() + faf::JsonFramer::binaryHeaderSize, cbor.data() + cbor.size(), value);
+    });
+
+    std::cout << message.first << ":" << std::endl
+              << "  JSON: " << json.size() << " bytes, encode " << jsonEncode << " us, decode " << jsonDecode << " us" << std::endl
+              << "  CBOR: " << cbor.size() << " bytes, encode " << cborEncode << " us, decode " << cborDecode << " us" << std::endl;
+  }
+
+  return 0;
+}
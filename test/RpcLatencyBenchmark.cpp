@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "JsonFramer.h"
+#include "JsonRpcServer.h"
+#include "logging.h"
+
+/* a status result with 15 relays, shaped like IceAdapter::status() */
+static Json::Value statusResult()
+{
+  Json::Value result;
+  result["version"] = "1.0.0";
+  result["options"]["player_id"] = 1;
+  result["options"]["player_login"] = "Rhiza";
+  result["gpgnet"]["connected"] = true;
+  result["gpgnet"]["game_state"] = "Lobby";
+  result["relays"] = Json::Value(Json::arrayValue);
+  for (int i = 0; i < 15; ++i)
+  {
+    Json::Value relay;
+    relay["remote_player_id"] = 100 + i;
+    relay["remote_player_login"] = "Player" + std::to_string(i);
+    relay["local_game_udp_port"] = 50000 + i;
+    relay["ice"]["state"] = "connected";
+    relay["ice"]["loc_cand_addr"] = "192.168.1.2:5" + std::to_string(1000 + i);
+    relay["ice"]["rem_cand_addr"] = "93.184.216." + std::to_string(i) + ":5" + std::to_string(2000 + i);
+    relay["ice"]["smoothed_rtt_ms"] = 31.25 + i;
+    result["relays"].append(relay);
+  }
+  return result;
+}
+
+/* blocking client: send a status request and wait for its response */
+static bool statusRoundTrip(int fd, int id, faf::JsonFramer& framer)
+{
+  std::string request = "{\"jsonrpc\":\"2.0\",\"method\":\"status\",\"params\":[],\"id\":" + std::to_string(id) + "}";
+  if (::send(fd, request.data(), request.size(), 0) != static_cast<ssize_t>(request.size()))
+  {
+    return false;
+  }
+  bool received = false;
+  while (!received)
+  {
+    ssize_t size = ::recv(fd, framer.prepare(4096), 4096, 0);
+    if (size <= 0)
+    {
+      return false;
+    }
+    framer.commit(std::size_t(size));
+    framer.parse([&](const char*, const char*, bool)
+    {
+      received = true;
+    });
+  }
+  return true;
+}
+
+static void measure(char const* name, int fd)
+{
+  static constexpr int warmup = 100;
+  static constexpr int iterations = 2000;
+  faf::JsonFramer framer;
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  for (int i = 0; i < warmup + iterations; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+    if (!statusRoundTrip(fd, i, framer))
+    {
+      std::cerr << name << ": round trip failed" << std::endl;
+      return;
+    }
+    if (i >= warmup)
+    {
+      samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double sample : samples)
+  {
+    sum += sample;
+  }
+  std::cout << name << ": mean " << sum / samples.size()
+            << " us, median " << samples[samples.size() / 2]
+            << " us, p99 " << samples[samples.size() * 99 / 100]
+            << " us over " << samples.size() << " status calls" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  faf::logging_init("warn");
+
+  faf::JsonRpcServer server;
+  Json::Value status = statusResult();
+  server.setRpcCallback("status", [&status](Json::Value const& paramsArray,
+                                            Json::Value & result,
+                                            Json::Value & error,
+                                            rtc::AsyncSocket* socket)
+  {
+    result = status;
+  });
+  server.listen(0);
+  std::string path = "/tmp/faf-ice-adapter-rpc-benchmark-" + std::to_string(::getpid()) + ".sock";
+  server.listenUnix(path);
+  int port = server.listenPort();
+
+  std::atomic<bool> done{false};
+  std::thread client([&]()
+  {
+    int tcpFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in tcpAddr;
+    std::memset(&tcpAddr, 0, sizeof(tcpAddr));
+    tcpAddr.sin_family = AF_INET;
+    tcpAddr.sin_port = htons(static_cast<uint16_t>(port));
+    tcpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(tcpFd, reinterpret_cast<sockaddr*>(&tcpAddr), sizeof(tcpAddr)) == 0)
+    {
+      measure("TCP loopback", tcpFd);
+    }
+    ::close(tcpFd);
+
+    int unixFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un unixAddr;
+    std::memset(&unixAddr, 0, sizeof(unixAddr));
+    unixAddr.sun_family = AF_UNIX;
+    std::strncpy(unixAddr.sun_path, path.c_str(), sizeof(unixAddr.sun_path) - 1);
+    if (::connect(unixFd, reinterpret_cast<sockaddr*>(&unixAddr), sizeof(unixAddr)) == 0)
+    {
+      measure("UNIX socket ", unixFd);
+    }
+    ::close(unixFd);
+    done = true;
+  });
+
+  while (!done)
+  {
+    rtc::Thread::Current()->ProcessMessages(10);
+  }
+  client.join();
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <webrtc/rtc_base/asyncsocket.h>
+#include <webrtc/rtc_base/sigslot.h>
+
+#include "GPGNetMessage.h"
+#include "Signal.h"
+
+/* receivers shaped like GPGNetServer -> IceAdapter and the game socket -> PeerRelay */
+class Receiver : public sigslot::has_slots<>
+{
+public:
+  void onGpgNetMessageByValue(faf::GPGNetMessage message)
+  {
+    chunks += message.chunks.size();
+  }
+
+  void onGpgNetMessage(faf::GPGNetMessage const& message)
+  {
+    chunks += message.chunks.size();
+  }
+
+  void onRead(rtc::AsyncSocket* socket)
+  {
+    reads += socket != nullptr;
+  }
+
+  uint64_t chunks{0};
+  uint64_t reads{0};
+};
+
+/* GPGNetServer re-emits the messages of its connection handlers */
+class Forwarder : public sigslot::has_slots<>
+{
+public:
+  void forwardByValue(faf::GPGNetMessage message)
+  {
+    SigslotMessage.emit(message);
+  }
+
+  void forward(faf::GPGNetMessage const& message)
+  {
+    SignalMessage.emit(message);
+  }
+
+  sigslot::signal1<faf::GPGNetMessage, sigslot::multi_threaded_local> SigslotMessage;
+  faf::Signal<faf::GPGNetMessage const&> SignalMessage;
+};
+
+static constexpr int iterations = 1000000;
+
+template<class Function>
+static double measureNs(Function&& function)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    function();
+  }
+  auto duration = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / double(iterations);
+}
+
+int main(int argc, char *argv[])
+{
+  faf::GPGNetMessage message;
+  message.header = "GameState";
+  message.chunks.push_back(std::string("Lobby"));
+  /* any non-null socket pointer, the receivers don't use it */
+  auto socket = reinterpret_cast<rtc::AsyncSocket*>(&message);
+
+  Receiver receiver;
+  Forwarder server;
+
+  /* GPGNetConnectionHandler -> GPGNetServer -> IceAdapter */
+  sigslot::signal1<faf::GPGNetMessage, sigslot::multi_threaded_local> sigslotHandlerMessage;
+  sigslotHandlerMessage.connect(&server, &Forwarder::forwardByValue);
+  server.SigslotMessage.connect(&receiver, &Receiver::onGpgNetMessageByValue);
+
+  faf::Signal<faf::GPGNetMessage const&> handlerMessage;
+  handlerMessage.connect(&server, &Forwarder::forward);
+  server.SignalMessage.connect(&receiver, &Receiver::onGpgNetMessage);
+
+  sigslot::signal1<rtc::AsyncSocket*, sigslot::multi_threaded_local> sigslotRead;
+  sigslotRead.connect(&receiver, &Receiver::onRead);
+
+  faf::Signal<rtc::AsyncSocket*> read;
+  read.connect(&receiver, &Receiver::onRead);
+
+  double sigslotMessageNs = measureNs([&]() { sigslotHandlerMessage.emit(message); });
+  double messageNs = measureNs([&]() { handlerMessage.emit(message); });
+  double sigslotReadNs = measureNs([&]() { sigslotRead.emit(socket); });
+  double readNs = measureNs([&]() { read.emit(socket); });
+
+  if (receiver.chunks != 2 * iterations ||
+      receiver.reads != 2 * iterations)
+  {
+    std::cerr << "missed emits" << std::endl;
+    return 1;
+  }
+
+  std::cout << "GPGNet message: sigslot " << sigslotMessageNs << " ns, Signal " << messageNs << " ns per message" << std::endl
+            << "UDP read event: sigslot " << sigslotReadNs << " ns, Signal " << readNs << " ns per event" << std::endl;
+  return 0;
+}
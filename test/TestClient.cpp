@@ -67,9 +67,9 @@ TestClient::TestClient(std::string const& login):
       params.append(_id);
       params.append(msg.header);
       Json::Value gpgChunks(Json::arrayValue);
-      for (auto chunk : msg.chunks)
+      for (auto const& chunk : msg.chunks)
       {
-        gpgChunks.append(chunk);
+        gpgChunks.append(GPGNetMessage::chunkToJson(chunk));
       }
       params.append(gpgChunks);
       _controlConnection.sendRequest("onMasterEvent", params);
@@ -246,9 +246,17 @@ void TestClient::_rpcSendToGpgNet(Json::Value const& paramsArray, Json::Value &
   }
   GPGNetMessage msg;
   msg.header = paramsArray[0].asString();
-  for (auto chunk: paramsArray[1])
+  try
   {
-    msg.chunks.push_back(chunk);
+    for (auto chunk: paramsArray[1])
+    {
+      msg.chunks.push_back(GPGNetMessage::chunkFromJson(chunk));
+    }
+  }
+  catch (std::exception& e)
+  {
+    error = e.what();
+    return;
   }
   _gpgNetClient.sendMessage(msg);
 }
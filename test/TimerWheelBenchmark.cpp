@@ -0,0 +1,101 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <webrtc/rtc_base/thread.h>
+
+#include "Timer.h"
+#include "logging.h"
+
+/* the former Timer implementation, one delayed message per timer */
+class LegacyTimer : public rtc::MessageHandler
+{
+public:
+  void start(int intervalMs, std::function<void()> callback)
+  {
+    stop();
+    _interval = intervalMs;
+    _callback = callback;
+    rtc::Thread::Current()->Clear(this);
+    rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, _interval, this);
+  }
+  void stop()
+  {
+    _callback = std::function<void()>();
+    rtc::Thread::Current()->Clear(this);
+  }
+protected:
+  virtual void OnMessage(rtc::Message* msg) override
+  {
+    if (_callback)
+    {
+      rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, _interval, this);
+      auto callback = _callback;
+      callback();
+    }
+  }
+  int _interval{0};
+  std::function<void()> _callback;
+};
+
+static constexpr int timerCount = 5000;
+static constexpr int rounds = 20;
+
+template<class TimerType>
+static void measure(char const* name)
+{
+  std::vector<std::unique_ptr<TimerType>> timers;
+  for (int i = 0; i < timerCount; ++i)
+  {
+    timers.emplace_back(new TimerType());
+  }
+  int fired = 0;
+  auto callback = [&fired]() { ++fired; };
+
+  /* re-arm all timers like deadlines pushed back on every packet */
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round)
+  {
+    for (int i = 0; i < timerCount; ++i)
+    {
+      timers[i]->start(1000 + (i * 7 + round * 13) % 5000, callback);
+    }
+  }
+  auto rearmDuration = std::chrono::steady_clock::now() - start;
+
+  /* let short timers fire for a while */
+  for (int i = 0; i < timerCount; ++i)
+  {
+    timers[i]->start(1 + i % 50, callback);
+  }
+  start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500))
+  {
+    rtc::Thread::Current()->ProcessMessages(10);
+  }
+  auto fireDuration = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (auto& timer : timers)
+  {
+    timer->stop();
+  }
+  auto stopDuration = std::chrono::steady_clock::now() - start;
+
+  std::cout << name << ": re-arm " << std::chrono::duration_cast<std::chrono::nanoseconds>(rearmDuration).count() / double(timerCount * rounds)
+            << " ns, stop " << std::chrono::duration_cast<std::chrono::nanoseconds>(stopDuration).count() / double(timerCount)
+            << " ns per timer, " << fired << " expirations in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(fireDuration).count() << " ms with "
+            << timerCount << " timers" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  faf::logging_init("warn");
+
+  measure<faf::Timer>("TimerWheel  ");
+  measure<LegacyTimer>("PostDelayed ");
+  return 0;
+}
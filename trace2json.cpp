@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "EventTrace.h"
+
+/* Converts a binary trace written with --trace-file to the Chrome trace event
+ * format for chrome://tracing or https://ui.perfetto.dev, one track per peer. */
+
+using namespace faf;
+
+static const char* iceConnectionStateName(uint64_t state)
+{
+  static const char* names[] = {"new", "checking", "connected", "completed", "failed", "disconnected", "closed"};
+  return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+
+static const char* iceGatheringStateName(uint64_t state)
+{
+  static const char* names[] = {"new", "gathering", "complete"};
+  return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+
+static const char* dataChannelStateName(uint64_t state)
+{
+  static const char* names[] = {"connecting", "open", "closing", "closed"};
+  return state < sizeof(names) / sizeof(names[0]) ? names[state] : "unknown";
+}
+
+static const char* candidateTypeName(uint64_t type)
+{
+  static const char* names[] = {"host", "srflx", "prflx", "relay"};
+  return type < sizeof(names) / sizeof(names[0]) ? names[type] : "unknown";
+}
+
+static const char* sdpTypeName(uint64_t type)
+{
+  return type == static_cast<uint64_t>(TraceSdpType::Offer) ? "offer" : "answer";
+}
+
+static const char* packetActionName(uint64_t action)
+{
+  static const char* names[] = {"sent", "bundled", "queued", "dropped"};
+  return action < sizeof(names) / sizeof(names[0]) ? names[action] : "unknown";
+}
+
+/* TraceHeader without the atomic, to read the raw bytes of the file into */
+struct TraceFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint64_t capacity;
+  uint64_t startTimeNs;
+  uint64_t startUnixTimeMs;
+  uint64_t written;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(TraceFileHeader) == sizeof(TraceHeader), "TraceFileHeader doesn't match TraceHeader");
+
+class ChromeTraceWriter
+{
+public:
+  explicit ChromeTraceWriter(std::ostream& out):
+    _out(out)
+  {
+  }
+
+  void begin(TraceFileHeader const& header, uint64_t records, uint64_t overwritten)
+  {
+    _out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{"
+         << "\"start_unix_time_ms\":" << header.startUnixTimeMs
+         << ",\"records\":" << records
+         << ",\"overwritten_records\":" << overwritten
+         << "},\"traceEvents\":[\n";
+  }
+
+  void end()
+  {
+    _out << "\n]}\n";
+  }
+
+  void record(TraceRecord const& record, double ts)
+  {
+    int relay = record.relayId;
+    if (_relays.count(relay) == 0)
+    {
+      _relays[relay] = Relay();
+      _event("M", "thread_name", relay, 0, "\"name\":\"peer " + std::to_string(relay) + "\"");
+    }
+    _lastTs = std::max(_lastTs, ts);
+    switch (static_cast<TraceEvent>(record.event))
+    {
+      case TraceEvent::RelayCreated:
+        _instant("relay created", relay, ts, std::string("\"offerer\":") + (record.a ? "true" : "false"));
+        break;
+      case TraceEvent::RelayDestroyed:
+        _closeIceState(relay, ts);
+        _instant("relay destroyed", relay, ts);
+        break;
+      case TraceEvent::IceConnectionState:
+        _closeIceState(relay, ts);
+        _relays[relay].iceState = iceConnectionStateName(record.a);
+        _relays[relay].iceStateTs = ts;
+        break;
+      case TraceEvent::IceGatheringState:
+        _instant(std::string("gathering ") + iceGatheringStateName(record.a), relay, ts);
+        break;
+      case TraceEvent::LocalCandidate:
+        _instant("local candidate", relay, ts, std::string("\"type\":\"") + candidateTypeName(record.a) + "\"");
+        break;
+      case TraceEvent::RemoteCandidate:
+        _instant("remote candidate", relay, ts, std::string("\"type\":\"") + candidateTypeName(record.a) + "\",\"queued\":" + (record.b ? "true" : "false"));
+        break;
+      case TraceEvent::LocalDescription:
+        _instant(std::string("local ") + sdpTypeName(record.a), relay, ts);
+        break;
+      case TraceEvent::RemoteDescription:
+        _instant(std::string("remote ") + sdpTypeName(record.a), relay, ts);
+        break;
+      case TraceEvent::RemoteDescriptionSet:
+        _instant("remote description set", relay, ts, std::string("\"success\":") + (record.a ? "true" : "false"));
+        break;
+      case TraceEvent::DataChannelState:
+        _instant(std::string("data channel ") + dataChannelStateName(record.a), relay, ts);
+        break;
+      case TraceEvent::Connected:
+        _instant(record.a ? "connected" : "disconnected", relay, ts);
+        break;
+      case TraceEvent::PingSent:
+        _instant("ping", relay, ts, "\"seq\":" + std::to_string(record.a) + ",\"sequenced\":" + (record.b ? "true" : "false"));
+        break;
+      case TraceEvent::PongReceived:
+        _instant("pong", relay, ts, "\"rtt_ms\":" + std::to_string(record.a / 1000.));
+        _event("C", "rtt peer " + std::to_string(relay), relay, ts, "\"rtt_ms\":" + std::to_string(record.a / 1000.));
+        break;
+      case TraceEvent::PacketFromGame:
+        _instant("from game", relay, ts, "\"size\":" + std::to_string(record.a) + ",\"action\":\"" + packetActionName(record.b) + "\"");
+        break;
+      case TraceEvent::PacketToGame:
+        _instant("to game", relay, ts, "\"size\":" + std::to_string(record.a));
+        break;
+      case TraceEvent::ReconnectFlushed:
+        _instant("reconnect queue flushed", relay, ts, "\"sent\":" + std::to_string(record.a) + ",\"expired\":" + std::to_string(record.b));
+        break;
+      default:
+        _instant("event " + std::to_string(record.event), relay, ts, "\"a\":" + std::to_string(record.a) + ",\"b\":" + std::to_string(record.b));
+        break;
+    }
+  }
+
+  /** \brief Close the ICE state spans still open at the end of the trace
+      */
+  void finish()
+  {
+    for (auto& relay : _relays)
+    {
+      _closeIceState(relay.first, _lastTs);
+    }
+  }
+
+protected:
+  struct Relay
+  {
+    std::string iceState;
+    double iceStateTs{0};
+  };
+
+  void _closeIceState(int relay, double ts)
+  {
+    auto& state = _relays[relay];
+    if (state.iceState.empty())
+    {
+      return;
+    }
+    char duration[64];
+    std::snprintf(duration, sizeof(duration), ",\"dur\":%.3f", ts - state.iceStateTs);
+    _separator();
+    _out << "{\"name\":\"ice " << state.iceState << "\",\"cat\":\"ice\",\"ph\":\"X\",\"pid\":1,\"tid\":" << relay
+         << ",\"ts\":" << _formatTs(state.iceStateTs) << duration << "}";
+    state.iceState.clear();
+  }
+
+  void _instant(std::string const& name, int relay, double ts, std::string const& args = std::string())
+  {
+    _event("i", name, relay, ts, args);
+  }
+
+  void _event(const char* phase, std::string const& name, int relay, double ts, std::string const& args)
+  {
+    _separator();
+    _out << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << relay
+         << ",\"ts\":" << _formatTs(ts);
+    if (std::strcmp(phase, "i") == 0)
+    {
+      _out << ",\"s\":\"t\"";
+    }
+    if (!args.empty())
+    {
+      _out << ",\"args\":{" << args << "}";
+    }
+    _out << "}";
+  }
+
+  static std::string _formatTs(double ts)
+  {
+    char result[32];
+    std::snprintf(result, sizeof(result), "%.3f", ts);
+    return result;
+  }
+
+  void _separator()
+  {
+    if (!_first)
+    {
+      _out << ",\n";
+    }
+    _first = false;
+  }
+
+  std::ostream& _out;
+  std::map<int, Relay> _relays;
+  bool _first{true};
+  double _lastTs{0};
+};
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " trace-file [output.json]" << std::endl;
+    return 1;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in)
+  {
+    std::cerr << "unable to open " << argv[1] << std::endl;
+    return 1;
+  }
+  in.seekg(0, std::ios::end);
+  auto fileSize = static_cast<uint64_t>(in.tellg());
+  in.seekg(0, std::ios::beg);
+  TraceFileHeader header;
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in ||
+      std::memcmp(header.magic, EventTrace::magic, sizeof(header.magic)) != 0 ||
+      header.version != EventTrace::version ||
+      header.recordSize != sizeof(TraceRecord))
+  {
+    std::cerr << argv[1] << " is not a faf-ice-adapter trace of version " << EventTrace::version << std::endl;
+    return 1;
+  }
+  /* a truncated or corrupt file holds fewer records than its header claims */
+  uint64_t fileRecords = (fileSize - sizeof(header)) / sizeof(TraceRecord);
+  std::vector<TraceRecord> records(static_cast<std::size_t>(std::min(header.capacity, fileRecords)));
+  in.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TraceRecord)));
+  records.resize(static_cast<std::size_t>(in.gcount()) / sizeof(TraceRecord));
+
+  uint64_t written = header.written;
+  uint64_t overwritten = written > header.capacity ? written - header.capacity : 0;
+  /* drop unwritten records, records written concurrently may be slightly out of order */
+  records.erase(std::remove_if(records.begin(), records.end(), [](TraceRecord const& r)
+  {
+    return r.timeNs == 0;
+  }), records.end());
+  std::stable_sort(records.begin(), records.end(), [](TraceRecord const& a, TraceRecord const& b)
+  {
+    return a.timeNs < b.timeNs;
+  });
+
+  std::ofstream file;
+  if (argc >= 3)
+  {
+    file.open(argv[2]);
+    if (!file)
+    {
+      std::cerr << "unable to create " << argv[2] << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = argc >= 3 ? file : std::cout;
+  ChromeTraceWriter writer(out);
+  writer.begin(header, records.size(), overwritten);
+  for (auto const& record : records)
+  {
+    double ts = record.timeNs >= header.startTimeNs ? (record.timeNs - header.startTimeNs) / 1000. : 0.;
+    writer.record(record, ts);
+  }
+  writer.finish();
+  writer.end();
+  return 0;
+}